@@ -4,6 +4,8 @@
 #include "smt.h"
 #include "utils.h"
 #include "value.h"
+#include <algorithm>
+#include <iterator>
 #include <map>
 
 using namespace smt;
@@ -110,6 +112,23 @@ pair<Expr, Expr> insertInitialValue(const Expr &a, const Expr &n,
   return {arr, size};
 }
 
+// Combine elems with op as a balanced tree whose depth is log2(elems.size()).
+// Adjacent elements are combined first, so reductions of equal elements
+// (e.g., in src and tgt) are built from identical subterms.
+Expr reduceBalanced(vector<Expr> elems,
+    const function<Expr(const Expr &, const Expr &)> &op) {
+  assert(!elems.empty());
+  while (elems.size() > 1) {
+    vector<Expr> next;
+    for (size_t i = 0; i + 1 < elems.size(); i += 2)
+      next.push_back(op(elems[i], elems[i + 1]));
+    if (elems.size() % 2)
+      next.push_back(elems.back());
+    elems = move(next);
+  }
+  return elems[0];
+}
+
 }
 
 
@@ -124,11 +143,16 @@ void setAbstraction(
     bool noArithProperties,
     unsigned unrollFpSumBound,
     unsigned floatNonConstsCnt, set<llvm::APFloat> floatConsts,
+    set<llvm::APFloat> floatUnobservedConsts,
     bool floatHasInfOrNaN,
     unsigned doubleNonConstsCnt, set<llvm::APFloat> doubleConsts,
+    set<llvm::APFloat> doubleUnobservedConsts,
     bool doubleHasInfOrNaN) {
   abstraction = abs;
   doUnrollIntSum = unrollIntSum;
+  // Their domains depend on Index::BITS, which may differ per validation.
+  int_sumfn.clear();
+  int_dotfn.clear();
   maxUnrollFpSumBound = unrollFpSumBound;
   hasArithProperties = !noArithProperties;
   isFpAddAssociative = addAssoc;
@@ -161,6 +185,7 @@ void setAbstraction(
       min((uint64_t) 31, log2_ceil(floatNonConstsCnt + floatConsts.size() + 2));
   floatEnc.emplace(llvm::APFloat::IEEEsingle(), floatBits, "float");
   floatEnc->addConstants(floatConsts);
+  floatEnc->addUnobservedConstants(move(floatUnobservedConsts));
 
   if (abstraction.fpCast == AbsLevelFpCast::PRECISE) {
     unsigned consts_nonzero_limit = 0;
@@ -231,6 +256,7 @@ void setAbstraction(
     doubleEnc.emplace(llvm::APFloat::IEEEdouble(), doubleBits, "double");
   }
   doubleEnc->addConstants(doubleConsts);
+  doubleEnc->addUnobservedConstants(move(doubleUnobservedConsts));
 }
 
 // A set of options that must not change the precision of validation.
@@ -240,6 +266,11 @@ void setEncodingOptions(bool use_multiset) {
 
 bool getFpAddAssociativity() { return isFpAddAssociative; }
 
+bool hasSharedFpLadders() {
+  return (floatEnc && floatEnc->hasSharedLadders()) ||
+      (doubleEnc && doubleEnc->hasSharedLadders());
+}
+
 bool getFpCastIsPrecise() { 
   return abstraction.fpCast == AbsLevelFpCast::PRECISE;
 }
@@ -367,14 +398,13 @@ FnDecl AbsFpEncoding::getExpFn() {
   return *fp_expfn;
 }
 
-FnDecl AbsFpEncoding::getHashFnForAddAssoc() {
+FnDecl AbsFpEncoding::getHashFnForAddAssoc(size_t rangeBits) {
   if (!fp_hashfn) {
     auto fty = sort();
-    fp_hashfn.emplace(fty, Sort::bvSort(getHashRangeBits()),
-        "fp_hash_" + fn_suffix);
+    fp_hashfn.emplace(fty, Sort::bvSort(rangeBits), "fp_hash_" + fn_suffix);
   } else {
     // Hash range bits must not be changed.
-    assert(fp_hashfn->getRange().bitwidth() == getHashRangeBits());
+    assert(fp_hashfn->getRange().bitwidth() == rangeBits);
   }
   return *fp_hashfn;
 }
@@ -406,23 +436,94 @@ FnDecl AbsFpEncoding::getInt32ToFpFn() {
   return *fp_sint32tofp_fn;
 }
 
-size_t AbsFpEncoding::getHashRangeBits() const {
-  uint64_t numSums = fp_sums.size();
+size_t AbsFpEncoding::getHashRangeBits(uint64_t numPairs) const {
   uint64_t maxLength = 0;
 
   for (auto &rel: fp_sums) {
     maxLength = max(maxLength, rel.len);
   }
 
-  uint64_t bounds = numSums * numSums * maxLength;
+  // Each related pair must be distinguishable by the hash.
+  uint64_t bounds = 2 * numPairs * maxLength;
   return max((uint64_t)1, log2_ceil(bounds));
 }
 
+vector<pair<unsigned, unsigned>> AbsFpEncoding::getRelatedSumPairs() const {
+  // A cheap signature of the elements of each summation: the numerals
+  // except the identity (sorted), and the number of the other elements.
+  // The identity is ignored because sum([a]) = sum([a, -0.0]).
+  uint64_t identity;
+  bool hasIdentity = zero(true).isUInt(identity);
+  vector<vector<uint64_t>> numerals(fp_sums.size());
+  vector<uint64_t> numSymbolic(fp_sums.size(), 0);
+
+  for (unsigned i = 0; i < fp_sums.size(); i ++) {
+    const auto &[a, aelems, alen, asum] = fp_sums[i];
+    for (unsigned j = 0; j < alen; j ++) {
+      auto elem = !aelems.empty() ? aelems[j] : a.select(Index(j)).simplify();
+      uint64_t v;
+      if (!elem.isUInt(v))
+        numSymbolic[i]++;
+      else if (!hasIdentity || v != identity)
+        numerals[i].push_back(v);
+    }
+    sort(numerals[i].begin(), numerals[i].end());
+  }
+
+  // The elements of A and B can be equal only if the numerals of A missing
+  // in B can be matched by the symbolic elements of B, and vice versa.
+  auto canBeEqual = [&](unsigned i, unsigned j) {
+    vector<uint64_t> onlyI, onlyJ;
+    set_difference(numerals[i].begin(), numerals[i].end(),
+        numerals[j].begin(), numerals[j].end(), back_inserter(onlyI));
+    set_difference(numerals[j].begin(), numerals[j].end(),
+        numerals[i].begin(), numerals[i].end(), back_inserter(onlyJ));
+    return onlyI.size() <= numSymbolic[j] && onlyJ.size() <= numSymbolic[i];
+  };
+
+  // Sums of numerals only can be equal only if their numerals are exactly
+  // the same, so they are bucketed by the numerals. Relating each one to the
+  // next one in its bucket is enough, since equality is transitive.
+  map<vector<uint64_t>, unsigned> lastOfBucket;
+  vector<unsigned> bucketReps, symbolicSums;
+  vector<pair<unsigned, unsigned>> pairs;
+  for (unsigned i = 0; i < fp_sums.size(); i ++) {
+    if (numSymbolic[i]) {
+      symbolicSums.push_back(i);
+      continue;
+    }
+    auto [itr, inserted] = lastOfBucket.try_emplace(numerals[i], i);
+    if (inserted)
+      bucketReps.push_back(i);
+    else {
+      pairs.emplace_back(itr->second, i);
+      itr->second = i;
+    }
+  }
+
+  // A sum having symbolic elements is compared with the other symbolic sums
+  // and one sum from each bucket.
+  for (unsigned x = 0; x < symbolicSums.size(); x ++) {
+    unsigned i = symbolicSums[x];
+    for (unsigned y = x + 1; y < symbolicSums.size(); y ++)
+      if (canBeEqual(i, symbolicSums[y]))
+        pairs.emplace_back(i, symbolicSums[y]);
+    for (unsigned j: bucketReps)
+      if (canBeEqual(i, j))
+        pairs.emplace_back(min(i, j), max(i, j));
+  }
+  return pairs;
+}
+
 uint64_t AbsFpEncoding::getSignBit() const {
   assert(value_bitwidth + SIGN_BITS == fp_bitwidth);
   return 1ull << value_bitwidth;
 }
 
+void AbsFpEncoding::addUnobservedConstants(set<llvm::APFloat> &&const_set) {
+  fpconst_unobserved = move(const_set);
+}
+
 void AbsFpEncoding::addConstants(const set<llvm::APFloat>& const_set) {
   uint64_t value_id = 0;
   Expr small_value_bits = Expr::mkBV(0, value_bit_info.truncated_bitwidth);
@@ -546,12 +647,22 @@ Expr AbsFpEncoding::constant(const llvm::APFloat &f) const {
     return f.isNegative() ? *fpconst_min : *fpconst_max;
   }
 
-  // all other constant values in src and tgt IRs are added at analysis stage,
-  // so this expression should never fail!
+  // All other constant values that may reach the returned values, memory, or
+  // UB are added at analysis stage, so this lookup should never fail for
+  // them. The constants of unobservable ops can be any value.
   auto itr = fpconst_absrepr.find(f);
-  assert(itr != fpconst_absrepr.end()
-          && "This constant does not have assigned abstract representation!");
-  return itr->second;
+  if (itr != fpconst_absrepr.end())
+    return itr->second;
+
+  auto absf = f;
+  absf.clearSign();
+  if (!fpconst_unobserved.count(absf)) {
+    verbose("AbsFpEncoding") << fn_suffix << ": constant "
+        << f.convertToDouble() << " has no abstract representation!\n";
+    assert(false &&
+        "This constant does not have assigned abstract representation!");
+  }
+  return Expr::mkFreshVar(sort(), "fp_const_unobserved");
 }
 
 vector<pair<llvm::APFloat, Expr>> AbsFpEncoding::getAllConstants() const {
@@ -700,6 +811,22 @@ Expr AbsFpEncoding::add(const Expr &_f1, const Expr &_f2) {
   if (!hasArithProperties)
     return getAddFn().apply({_f1, _f2});
 
+  // Constants are folded by the ladder.
+  if (_f1.isNumeral() && _f2.isNumeral())
+    return addLadder(_f1, _f2);
+  return getAddLadder().select({_f1, _f2});
+}
+
+Expr AbsFpEncoding::getAddLadder() {
+  if (!fp_add_ladder) {
+    auto x = Expr::mkVar(sort(), "fp_add_x", true);
+    auto y = Expr::mkVar(sort(), "fp_add_y", true);
+    fp_add_ladder = Expr::mkLambda({x, y}, addLadder(x, y));
+  }
+  return *fp_add_ladder;
+}
+
+Expr AbsFpEncoding::addLadder(const Expr &_f1, const Expr &_f2) {
   const auto fp_id = zero(true);
   const auto fp_inf_pos = infinity();
   const auto fp_inf_neg = infinity(true);
@@ -758,6 +885,22 @@ Expr AbsFpEncoding::mul(const Expr &_f1, const Expr &_f2) {
   if (!hasArithProperties)
     return getMulFn().apply({_f1, _f2});
 
+  // Constants are folded by the ladder.
+  if (_f1.isNumeral() && _f2.isNumeral())
+    return mulLadder(_f1, _f2);
+  return getMulLadder().select({_f1, _f2});
+}
+
+Expr AbsFpEncoding::getMulLadder() {
+  if (!fp_mul_ladder) {
+    auto x = Expr::mkVar(sort(), "fp_mul_x", true);
+    auto y = Expr::mkVar(sort(), "fp_mul_y", true);
+    fp_mul_ladder = Expr::mkLambda({x, y}, mulLadder(x, y));
+  }
+  return *fp_mul_ladder;
+}
+
+Expr AbsFpEncoding::mulLadder(const Expr &_f1, const Expr &_f2) {
   auto fp_id = one();
   auto fp_minusone = one(true);
   auto fp_inf_pos = infinity();
@@ -994,7 +1137,9 @@ Expr AbsFpEncoding::sum(const Expr &a, const Expr &n,
       auto sum = arr.select(Index(0));
       for (auto i = 1; i < length; i++) {
         sum = add(sum, arr.select(Index(i)));
-        sum = sum.simplify();
+        // simplify() would inline the shared add ladder.
+        if (!hasArithProperties)
+          sum = sum.simplify();
       }
       sumExpr = sum;
     }
@@ -1230,13 +1375,18 @@ Expr AbsFpEncoding::getFpAssociativePrecondition() {
     return precond;
   }
 
+  auto pairs = getRelatedSumPairs();
+  verbose("fpAssoc") << pairs.size() << " pairs of " << fp_sums.size()
+      << " sums may be equal\n";
+  auto hashBits = getHashRangeBits(pairs.size());
+
   vector<optional<Expr>> hashValues(fp_sums.size());
-  auto hashfn = getHashFnForAddAssoc();
+  auto hashfn = getHashFnForAddAssoc(hashBits);
 
   for (unsigned i = 0; i < fp_sums.size(); i ++) {
     const auto &[a, aelems, alen, asum] = fp_sums[i];
 
-    auto aVal = Expr::mkBV(0, getHashRangeBits());
+    auto aVal = Expr::mkBV(0, hashBits);
 
     for (unsigned j = 0; j < alen; j ++) {
       auto elem = !aelems.empty() ? aelems[j] : a.select(Index(j));
@@ -1253,33 +1403,26 @@ Expr AbsFpEncoding::getFpAssociativePrecondition() {
   }
 
   // precondition between `hashfn <-> sumfn`
+  // Only the pairs whose elements can be equal are related.
   Expr precond = Expr::mkBool(true);
-  for (unsigned i = 0; i < fp_sums.size(); i ++) {
-    const auto &[a, aelems, alen, asum] = fp_sums[i];
-
-    for (unsigned j = i + 1; j < fp_sums.size(); j ++) {
-      const auto &[b, belems, blen, bsum] = fp_sums[j];
-
-      // if addf, sumfn are repective, we only consider same length array
-      if (abstraction.fpAddSumEncoding == AbsFpAddSumEncoding::DEFAULT &&
-          alen != blen)
-        continue;
-
-      auto aVal = *hashValues[i];
-      auto bVal = *hashValues[j];
-      // precond: sumfn(A) != sumfn(B) -> hashfn(A) != hashfn(B)
-      // This means if two summations are different, we can find concrete hash
-      // function that hashes into different value.
-      auto associativity = (!(asum == bsum)).implies(!(aVal == bVal));
-      precond = precond & associativity;
-    }
+  for (auto [i, j]: pairs) {
+    const auto &asum = fp_sums[i].sumExpr;
+    const auto &bsum = fp_sums[j].sumExpr;
+
+    auto aVal = *hashValues[i];
+    auto bVal = *hashValues[j];
+    // precond: sumfn(A) != sumfn(B) -> hashfn(A) != hashfn(B)
+    // This means if two summations are different, we can find concrete hash
+    // function that hashes into different value.
+    auto associativity = (!(asum == bsum)).implies(!(aVal == bVal));
+    precond = precond & associativity;
   }
 
   // To support summation without identity equals to orginal one
   //   sum([a])=sum([a, 0, 0])
   // add a precondition for hash(-0) = 0
   auto fpAddIdentity = zero(true);
-  auto hashIdentity = Expr::mkBV(0, getHashRangeBits());
+  auto hashIdentity = Expr::mkBV(0, hashBits);
   precond = precond & (hashfn.apply(fpAddIdentity) == hashIdentity);
 
   precond = precond.simplify();
@@ -1465,11 +1608,15 @@ Expr intSum(const Expr &a, const Expr &n,
   uint64_t length;
   if (doUnrollIntSum && size.isUInt(length)) {
     verbose("intSum") << "Unrolling sum whose size is " << length << "\n";
-    Expr s = Expr::mkBV(0, arri.bitwidth());
-    for (uint64_t j = 0; j < length; ++j) {
-      s = s + arr.select(Index(j));
-    }
-    return s;
+    if (length == 0)
+      return Expr::mkBV(0, arri.bitwidth());
+
+    vector<Expr> elems;
+    for (uint64_t j = 0; j < length; ++j)
+      elems.push_back(arr.select(Index(j)));
+    // bvadd is associative; a balanced tree keeps the term shallow.
+    return reduceBalanced(move(elems),
+        [](const Expr &a, const Expr &b) { return a + b; });
   }
 
   usedOps.intSum = true;
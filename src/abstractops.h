@@ -59,6 +59,8 @@ struct Abstraction {
 //                   size of an array to unroll
 // floatNonConstsCnt: # of non-constant distinct f32 values necessary to
 // validate the transformation.
+// floatUnobservedConsts: f32 constants that are used only by the ops whose
+// values cannot be observed. They may have no abstract representation.
 // NOTE: This resets the used abstract ops record, but does not reset encoding
 //    options (see setEncodingOptions).
 void setAbstraction(Abstraction abs,
@@ -68,9 +70,11 @@ void setAbstraction(Abstraction abs,
                     unsigned unrollFpSumBound,
                     unsigned floatNonConstsCnt,
                     std::set<llvm::APFloat> floatConsts,
+                    std::set<llvm::APFloat> floatUnobservedConsts,
                     bool floatHasInfOrNaN,
                     unsigned doubleNonConstsCnt,
                     std::set<llvm::APFloat> doubleConsts,
+                    std::set<llvm::APFloat> doubleUnobservedConsts,
                     bool doubleHasInfOrNaN);
 // A set of options that must not change the precision of validation.
 // useMultiset: To encode commutativity of fp summation, use multiset?
@@ -78,6 +82,8 @@ void setEncodingOptions(bool useMultiset);
 
 bool getFpAddAssociativity();
 bool getFpCastIsPrecise();
+// Do fp add/mul select from the shared ladders? simplify() inlines them.
+bool hasSharedFpLadders();
 
 smt::Expr getFpTruncatePrecondition();
 smt::Expr getFpAssociativePrecondition();
@@ -108,6 +114,8 @@ private:
   std::optional<smt::Expr> fpconst_max;
   // Abstract representation of valid fp constants (except +-0.0, min, max).
   std::map<llvm::APFloat, smt::Expr> fpconst_absrepr;
+  // Constants of unobservable ops; they need no abstract representation.
+  std::set<llvm::APFloat> fpconst_unobserved;
 
   const static unsigned SIGN_BITS = 1;
   // The BV width of abstract fp encoding.
@@ -151,6 +159,11 @@ private:
   std::optional<smt::FnDecl> fp_rounddirfn;
   std::optional<smt::FnDecl> fp_maxfn;
   std::optional<smt::FnDecl> fp_sint32tofp_fn;
+  // The special cases of add/mul around fp_add/fp_mul, as lambdas over two
+  // operands. add() and mul() select from them instead of building the
+  // ladder at every call.
+  std::optional<smt::Expr> fp_add_ladder;
+  std::optional<smt::Expr> fp_mul_ladder;
   std::string fn_suffix;
 
 private:
@@ -175,6 +188,10 @@ public:
     return smt::Sort::bvSort(fp_bitwidth);
   }
 
+  bool hasSharedLadders() const {
+    return fp_add_ladder.has_value() || fp_mul_ladder.has_value();
+  }
+
 private:
   smt::FnDecl getAddFn();
   smt::FnDecl getMulFn();
@@ -185,16 +202,26 @@ private:
   smt::FnDecl getExtendFn(const AbsFpEncoding &tgt);
   smt::FnDecl getTruncateFn(const AbsFpEncoding &tgt);
   smt::FnDecl getExpFn();
-  smt::FnDecl getHashFnForAddAssoc();
+  smt::FnDecl getHashFnForAddAssoc(size_t rangeBits);
   smt::FnDecl getRoundDirFn();
   smt::FnDecl getMaxFn();
   smt::FnDecl getInt32ToFpFn();
 
-  size_t getHashRangeBits() const;
+  smt::Expr getAddLadder();
+  smt::Expr getMulLadder();
+  smt::Expr addLadder(const smt::Expr &f1, const smt::Expr &f2);
+  smt::Expr mulLadder(const smt::Expr &f1, const smt::Expr &f2);
+
+  size_t getHashRangeBits(uint64_t numPairs) const;
+  // The pairs (i, j), i < j, of fp_sums to relate. Two sums whose elements
+  // can be equal as multisets are related directly or through a chain of
+  // pairs.
+  std::vector<std::pair<unsigned, unsigned>> getRelatedSumPairs() const;
   uint64_t getSignBit() const;
 
 public:
   void addConstants(const std::set<llvm::APFloat>& const_set);
+  void addUnobservedConstants(std::set<llvm::APFloat> &&const_set);
   smt::Expr constant(const llvm::APFloat &f) const;
   smt::Expr zero(bool isNegative = false) const;
   smt::Expr one(bool isNegative = false) const;
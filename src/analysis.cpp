@@ -4,7 +4,10 @@
 #include "utils.h"
 
 #include "mlir/IR/Matchers.h"
+#include "mlir/IR/TypeUtilities.h"
+#include "mlir/Dialect/Bufferization/IR/Bufferization.h"
 #include "mlir/Dialect/Tosa/IR/TosaOps.h"
+#include "llvm/Support/MathExtras.h"
 
 #include <type_traits>
 
@@ -18,7 +21,9 @@ using namespace std;
 
 namespace {
 
-void analyzeBlock(mlir::Block &block, AnalysisResult &res);
+// If observable is given, only the fp values of the ops in it are counted.
+void analyzeBlock(mlir::Block &block, AnalysisResult &res,
+    const llvm::DenseSet<mlir::Operation *> *observable = nullptr);
 
 // Return false if op is not processed
 template<class T> bool analyzeOp(T op, AnalysisResult &res);
@@ -114,12 +119,13 @@ bool analyzeElemAttr(
     if (denseAttr.isSplat()) {
       analyzeAttr(denseAttr.getSplatValue<mlir::Attribute>(), res);
     } else {
-      if (Tensor::MAX_CONST_SIZE >= 0 &&
-          denseAttr.getNumElements() > Tensor::MAX_CONST_SIZE)
+      if (!Tensor::getConstEncodingSize(denseAttr))
         return false;
 
-      for (const auto& attr: denseAttr.getValues<mlir::Attribute>()) {
-        analyzeAttr(attr, res);
+      auto elemTy = denseAttr.getElementType();
+      if (elemTy.isa<mlir::FloatType>()) {
+        for (const auto &val: denseAttr.getValues<llvm::APFloat>())
+          analyzeAPFloat(elemTy, val, res);
       }
     }
   } else if (auto sparseAttr = attr.dyn_cast<mlir::SparseElementsAttr>()) {
@@ -209,6 +215,78 @@ void analyzeVariable(
     memrefCnt[elemty]++;
 }
 
+// Return the element type of the block if op creates a new local block.
+optional<mlir::Type> getNewLocalBlockType(mlir::Operation *op) {
+  if (!mlir::isa<mlir::memref::AllocOp>(op) &&
+      !mlir::isa<mlir::memref::AllocaOp>(op) &&
+      !mlir::isa<mlir::bufferization::ToMemrefOp>(op) &&
+      !mlir::isa<mlir::bufferization::CloneOp>(op))
+    return nullopt;
+
+  return op->getResult(0).getType().cast<mlir::MemRefType>().getElementType();
+}
+
+// Compute the max. number of local blocks that are alive at the same time.
+// Blocks created in nested regions are conservatively assumed to be never
+// deallocated.
+void analyzeLiveLocalBlocks(mlir::Block &block, AnalysisResult &res) {
+  TypeMap<size_t> liveCount;
+  auto &maxCount = res.memref.maxLiveLocalCount;
+
+  auto addLiveBlock = [&](mlir::Type ty) {
+    auto cnt = ++liveCount[ty];
+    maxCount[ty] = max(maxCount[ty], cnt);
+  };
+
+  for (auto &op: block) {
+    if (auto ty = getNewLocalBlockType(&op))
+      addLiveBlock(*ty);
+
+    for (auto &region: op.getRegions())
+      region.walk([&](mlir::Operation *nestedOp) {
+        if (auto ty = getNewLocalBlockType(nestedOp))
+          addLiveBlock(*ty);
+      });
+
+    if (auto dealloc = mlir::dyn_cast<mlir::memref::DeallocOp>(op)) {
+      if (isBlockReusableAfter(dealloc)) {
+        auto ty = dealloc.memref().getType().cast<mlir::MemRefType>()
+            .getElementType();
+        --liveCount[ty];
+      }
+    }
+  }
+}
+
+// Is the memref v only read by its users (including the users of views of v)?
+// Note that bufferization.clone updates the writable flag of its operand.
+bool isReadOnlyMemRef(mlir::Value v) {
+  for (auto &use: v.getUses()) {
+    auto *user = use.getOwner();
+    if (mlir::isa<mlir::memref::LoadOp>(user) ||
+        mlir::isa<mlir::memref::DimOp>(user) ||
+        mlir::isa<mlir::bufferization::ToTensorOp>(user))
+      continue;
+
+    if (auto lop = mlir::dyn_cast<mlir::linalg::LinalgOp>(user)) {
+      if (llvm::is_contained(lop.getInputOperands(), &use))
+        continue;
+      return false;
+    }
+
+    if (mlir::isa<mlir::memref::SubViewOp>(user) ||
+        mlir::isa<mlir::memref::CollapseShapeOp>(user) ||
+        mlir::isa<mlir::memref::ExpandShapeOp>(user)) {
+      if (!isReadOnlyMemRef(user->getResult(0)))
+        return false;
+      continue;
+    }
+
+    return false;
+  }
+  return true;
+}
+
 void analyzeRegion(mlir::Region &region, AnalysisResult &res) {
   if (!region.hasOneBlock())
     throw UnsupportedException("Region with a single block is supported only");
@@ -303,9 +381,48 @@ bool analyzeOp(mlir::tensor::GenerateOp op, AnalysisResult &res) {
   return true;
 }
 
+// Record that op (or an op nested in it) creates fp values that are not
+// counted, and collect the fp constants used by them.
+void markUncountedFps(mlir::Operation *op, AnalysisResult &res) {
+  AnalysisResult unobserved;
+  op->walk([&res, &unobserved](mlir::Operation *inner) {
+    for (auto v: inner->getResults()) {
+      auto elemTy = mlir::getElementTypeOrSelf(v.getType());
+      if (elemTy.isF32())
+        res.F32.hasUncountedValues = true;
+      else if (elemTy.isF64())
+        res.F64.hasUncountedValues = true;
+    }
+
+    if (auto cop = mlir::dyn_cast<mlir::arith::ConstantFloatOp>(inner))
+      analyzeOp(cop, unobserved);
+    else if (auto cop = mlir::dyn_cast<mlir::arith::ConstantOp>(inner))
+      analyzeOp(cop, unobserved);
+    else if (auto cop = mlir::dyn_cast<mlir::tosa::ConstOp>(inner))
+      analyzeOp(cop, unobserved);
+    else if (auto cop = mlir::dyn_cast<mlir::tosa::ClampOp>(inner))
+      analyzeOp(cop, unobserved);
+  });
+  res.F32.unobservedConstSet.merge(unobserved.F32.constSet);
+  res.F64.unobservedConstSet.merge(unobserved.F64.constSet);
+}
+
 void analyzeBlock(
-    mlir::Block &block, AnalysisResult &res) {
+    mlir::Block &block, AnalysisResult &res,
+    const llvm::DenseSet<mlir::Operation *> *observable) {
   for (auto &op: block) {
+    if (observable && !observable->contains(&op)) {
+      // The fp values of op cannot affect the returned values, memory, or
+      // UB. They may be equal to any other value without changing the
+      // result, so do not count them. Neither do its constants need
+      // distinct abstract values; AbsFpEncoding::constant gives them
+      // unknown ones if they are not used by observable ops as well.
+      markUncountedFps(&op, res);
+      for (const auto &result: op.getResults())
+        analyzeVariable(result, res, VarAnalysisConfig::op(false));
+      continue;
+    }
+
     // Analyze constant operations
     // These operations do not increase varCount
     // If it is a constant tensor that is too large (> Tensor::MAX_CONST_SIZE),
@@ -365,6 +482,136 @@ void analyzeBlock(
 }
 }
 
+static void analyzeAffineMap(mlir::AffineMap map, IndexAnalysisResult &res) {
+  map.walkExprs([&res](mlir::AffineExpr e) {
+    if (auto c = e.dyn_cast<mlir::AffineConstantExpr>()) {
+      int64_t v = c.getValue();
+      uint64_t absv = v < 0 ? 0 - (uint64_t)v : (uint64_t)v;
+      res.maxStaticValue = max(res.maxStaticValue, absv);
+    }
+  });
+}
+
+static void analyzeShapedType(mlir::Type ty, IndexAnalysisResult &res) {
+  auto shapedTy = ty.dyn_cast<mlir::ShapedType>();
+  if (!shapedTy)
+    return;
+  if (!shapedTy.hasRank() || shapedTy.getElementType().isIndex()) {
+    res.hasUnboundedIndex = true;
+    return;
+  }
+
+  uint64_t numElems = 1;
+  bool isDynamic = false;
+  for (auto d: shapedTy.getShape()) {
+    if (d == mlir::ShapedType::kDynamicSize) {
+      isDynamic = true;
+      continue;
+    }
+    res.maxStaticValue = max(res.maxStaticValue, (uint64_t)d);
+    numElems = llvm::SaturatingMultiply(numElems, (uint64_t)d);
+  }
+
+  auto memrefTy = ty.dyn_cast<mlir::MemRefType>();
+  bool hasLayout = memrefTy && !memrefTy.getLayout().isIdentity();
+  if (hasLayout)
+    analyzeAffineMap(memrefTy.getLayout().getAffineMap(), res);
+
+  if (isDynamic) {
+    res.maxDynamicRank = max(res.maxDynamicRank, (unsigned)shapedTy.getRank());
+    // The addresses of a layout are not bounded by the dynamic tensor size.
+    if (hasLayout)
+      res.hasUnboundedIndex = true;
+    return;
+  }
+  res.maxStaticValue = max(res.maxStaticValue, numElems);
+
+  if (!hasLayout || numElems == 0)
+    return;
+
+  int64_t offset;
+  llvm::SmallVector<int64_t, 4> strides;
+  if (failed(mlir::getStridesAndOffset(memrefTy, strides, offset))) {
+    // The largest address of a non-strided layout is not computed.
+    res.hasUnboundedIndex = true;
+    return;
+  }
+
+  // The largest address is offset + sum((dim - 1) * stride).
+  if (offset == mlir::ShapedType::kDynamicStrideOrOffset || offset < 0) {
+    res.hasUnboundedIndex = true;
+    return;
+  }
+  uint64_t maxAddr = offset;
+  for (unsigned i = 0; i < strides.size(); ++i) {
+    if (strides[i] == mlir::ShapedType::kDynamicStrideOrOffset ||
+        strides[i] < 0) {
+      res.hasUnboundedIndex = true;
+      return;
+    }
+    maxAddr = llvm::SaturatingAdd(maxAddr, llvm::SaturatingMultiply(
+        (uint64_t)memrefTy.getDimSize(i) - 1, (uint64_t)strides[i]));
+  }
+  res.maxStaticValue =
+      max(res.maxStaticValue, llvm::SaturatingAdd(maxAddr, (uint64_t)1));
+}
+
+static void analyzeIntAttr(mlir::Attribute attr, IndexAnalysisResult &res) {
+  auto update = [&res](const llvm::APInt &v) {
+    if (v.getMinSignedBits() > 63) {
+      res.hasUnboundedIndex = true;
+      return;
+    }
+    int64_t i = v.getSExtValue();
+    res.maxStaticValue = max(res.maxStaticValue, (uint64_t)(i < 0 ? -i : i));
+  };
+
+  if (auto intAttr = attr.dyn_cast<mlir::IntegerAttr>()) {
+    update(intAttr.getValue());
+  } else if (auto mapAttr = attr.dyn_cast<mlir::AffineMapAttr>()) {
+    analyzeAffineMap(mapAttr.getValue(), res);
+  } else if (auto arrAttr = attr.dyn_cast<mlir::ArrayAttr>()) {
+    for (auto elem: arrAttr)
+      analyzeIntAttr(elem, res);
+  } else if (auto denseAttr = attr.dyn_cast<mlir::DenseIntElementsAttr>()) {
+    if (denseAttr.isSplat()) {
+      update(denseAttr.getSplatValue<llvm::APInt>());
+      return;
+    }
+    for (const llvm::APInt &v: denseAttr)
+      update(v);
+  }
+}
+
+// Find the range of index values of fn. Index values are bounded by the
+// shapes unless they are computed by arithmetic, casts, or arguments.
+static void analyzeIndices(mlir::FuncOp fn, IndexAnalysisResult &res) {
+  for (const auto &arg: fn.getArguments()) {
+    if (arg.getType().isIndex())
+      res.hasUnboundedIndex = true;
+    analyzeShapedType(arg.getType(), res);
+  }
+
+  fn.getBody().walk([&res](mlir::Operation *op) {
+    for (auto &attr: op->getAttrs())
+      analyzeIntAttr(attr.getValue(), res);
+
+    bool isBoundedIndexOp =
+        mlir::isa<mlir::arith::ConstantOp>(op) ||
+        mlir::isa<mlir::tensor::DimOp>(op) ||
+        mlir::isa<mlir::memref::DimOp>(op) ||
+        mlir::isa<mlir::linalg::IndexOp>(op);
+    for (const auto &result: op->getResults()) {
+      if (result.getType().isIndex() && !isBoundedIndexOp)
+        res.hasUnboundedIndex = true;
+      analyzeShapedType(result.getType(), res);
+    }
+  });
+}
+
+static llvm::DenseSet<mlir::Operation *> getFpObservableSlice(
+    mlir::FuncOp fn);
+
 AnalysisResult analyze(mlir::FuncOp &fn) {
   AnalysisResult res;
 
@@ -376,11 +623,24 @@ AnalysisResult analyze(mlir::FuncOp &fn) {
   // Step1. analyze arguments
   for (const auto& arg: fn.getArguments()){
     analyzeVariable(arg, res, VarAnalysisConfig::arg());
+    if (auto ty = arg.getType().dyn_cast<mlir::MemRefType>()) {
+      if (isReadOnlyMemRef(arg))
+        res.memref.readOnlyArgs.insert(arg.getArgNumber());
+      else
+        res.memref.writtenGlobalTypes.insert(ty.getElementType());
+    }
   }
+  fn.walk([&res](mlir::memref::GetGlobalOp op) {
+    if (!isReadOnlyMemRef(op.getResult()))
+      res.memref.writtenGlobalTypes.insert(op.getType().getElementType());
+  });
 
   // Step2. analyze the block
   auto &block = region.front();
-  analyzeBlock(block, res);
+  auto observable = getFpObservableSlice(fn);
+  analyzeBlock(block, res, &observable);
+  analyzeLiveLocalBlocks(block, res);
+  analyzeIndices(fn, res.index);
 
   verbose("analysis") << "<" << fn.getName().str() << ">\n";
   verbose("analysis") << "  fn has only elementwise op?: "
@@ -399,5 +659,149 @@ AnalysisResult analyze(mlir::FuncOp &fn) {
     verbose("analysis") << "  memref arg count (" << ty << "): " << cnt << "\n";
   for (auto &[ty, cnt]: res.memref.varCount)
     verbose("analysis") << "  memref var count (" << ty << "): " << cnt << "\n";
+  verbose("analysis") << "  max static index value: "
+      << res.index.maxStaticValue << "\n";
+  verbose("analysis") << "  max dynamic rank: " << res.index.maxDynamicRank
+      << "\n";
+  verbose("analysis") << "  has unbounded index?: "
+      << (res.index.hasUnboundedIndex ? "YES\n" : "NO\n");
+  verbose("analysis") << "  read-only memref args:";
+  for (auto i: res.memref.readOnlyArgs)
+    verbose("analysis") << " " << i;
+  verbose("analysis") << "\n";
+  for (auto &[ty, cnt]: res.memref.maxLiveLocalCount)
+    verbose("analysis") << "  memref max live local count (" << ty << "): "
+        << cnt << "\n";
   return res;
 }
+
+// Are v and the memrefs derived from v used only before op?
+static bool isUsedOnlyBefore(mlir::Value v, mlir::Operation *op) {
+  for (auto *user: v.getUsers()) {
+    if (user == op)
+      continue;
+
+    auto *userInBlock = op->getBlock()->findAncestorOpInBlock(*user);
+    if (!userInBlock || userInBlock == op || !userInBlock->isBeforeInBlock(op))
+      return false;
+
+    for (auto res: user->getResults()) {
+      if (res.getType().isa<mlir::MemRefType>() && !isUsedOnlyBefore(res, op))
+        return false;
+    }
+  }
+  return true;
+}
+
+bool isBlockReusableAfter(mlir::memref::DeallocOp op) {
+  auto memref = op.memref();
+  auto alloc = memref.getDefiningOp<mlir::memref::AllocOp>();
+  if (!alloc || alloc->getBlock() != op->getBlock())
+    return false;
+
+  return isUsedOnlyBefore(memref, op);
+}
+
+// Does op or an op nested in it access memory?
+static bool accessesMemory(mlir::Operation *op) {
+  auto isMemRef = [](mlir::Value v) {
+    return v.getType().isa<mlir::MemRefType>();
+  };
+  auto res = op->walk([&](mlir::Operation *inner) {
+    if (llvm::any_of(inner->getOperands(), isMemRef) ||
+        llvm::any_of(inner->getResults(), isMemRef))
+      return mlir::WalkResult::interrupt();
+    return mlir::WalkResult::advance();
+  });
+  return res.wasInterrupted();
+}
+
+static llvm::DenseSet<mlir::Operation *> computeBackwardSlice(
+    mlir::Block &block, vector<mlir::Operation *> worklist) {
+  llvm::DenseSet<mlir::Operation *> slice;
+  bool memoryAdded = false;
+
+  auto push = [&](mlir::Value v) {
+    auto *def = v.getDefiningOp();
+    if (!def)
+      return;
+    if (auto *defInBlock = block.findAncestorOpInBlock(*def))
+      worklist.push_back(defInBlock);
+  };
+
+  while (!worklist.empty()) {
+    auto *op = worklist.back();
+    worklist.pop_back();
+    if (!slice.insert(op).second)
+      continue;
+
+    // Operands of op and the ops nested in it
+    op->walk([&](mlir::Operation *inner) {
+      for (auto operand: inner->getOperands())
+        push(operand);
+    });
+
+    if (!memoryAdded && accessesMemory(op)) {
+      memoryAdded = true;
+      for (auto &op2: block) {
+        if (accessesMemory(&op2))
+          worklist.push_back(&op2);
+      }
+    }
+  }
+  return slice;
+}
+
+llvm::DenseSet<mlir::Operation *> getBackwardSlice(
+    mlir::FuncOp fn, llvm::ArrayRef<mlir::Value> values) {
+  auto &block = fn.getRegion().front();
+  vector<mlir::Operation *> worklist;
+  for (auto v: values) {
+    if (auto *def = v.getDefiningOp())
+      if (auto *defInBlock = block.findAncestorOpInBlock(*def))
+        worklist.push_back(defInBlock);
+  }
+  return computeBackwardSlice(block, move(worklist));
+}
+
+llvm::DenseSet<mlir::Operation *> getMemorySlice(mlir::FuncOp fn) {
+  auto &block = fn.getRegion().front();
+  vector<mlir::Operation *> worklist;
+  for (auto &op: block) {
+    if (accessesMemory(&op))
+      worklist.push_back(&op);
+  }
+  return computeBackwardSlice(block, move(worklist));
+}
+
+// Does op (and every op nested in it) only create fp values? Such values
+// can be observed or raise UB only through other ops.
+static bool createsOnlyFpValues(mlir::Operation *op) {
+  auto isFp = [](mlir::Value v) {
+    return !v.getType().isa<mlir::MemRefType>() &&
+        mlir::getElementTypeOrSelf(v.getType()).isa<mlir::FloatType>();
+  };
+  auto res = op->walk([&](mlir::Operation *inner) {
+    if (inner != op && inner->hasTrait<mlir::OpTrait::IsTerminator>())
+      return mlir::WalkResult::advance();
+    if (inner->getNumResults() == 0 ||
+        !llvm::all_of(inner->getResults(), isFp))
+      return mlir::WalkResult::interrupt();
+    return mlir::WalkResult::advance();
+  });
+  return !res.wasInterrupted();
+}
+
+// Return the ops whose fp values may be observed: the backward slice of the
+// ops that return values, access memory, or create non-fp values (which may
+// raise UB).
+static llvm::DenseSet<mlir::Operation *> getFpObservableSlice(
+    mlir::FuncOp fn) {
+  auto &block = fn.getRegion().front();
+  vector<mlir::Operation *> worklist;
+  for (auto &op: block) {
+    if (!createsOnlyFpValues(&op) || accessesMemory(&op))
+      worklist.push_back(&op);
+  }
+  return computeBackwardSlice(block, move(worklist));
+}
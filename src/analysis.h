@@ -3,6 +3,7 @@
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "utils.h"
+#include "llvm/ADT/DenseSet.h"
 #include <map>
 #include <optional>
 #include <set>
@@ -14,19 +15,57 @@ struct FPAnalysisResult {
   size_t argCount = 0;
   size_t varCount = 0;
   size_t elemsCount = 0;
+  // True if an op outside the observable slice creates values of this type.
+  // They are not counted, but at least one abstract value must exist.
+  bool hasUncountedValues = false;
+  // The constants used only by ops outside the observable slice
+  std::set<llvm::APFloat> unobservedConstSet;
 };
 
 struct MemRefAnalysisResult {
   TypeMap<size_t> argCount;
   TypeMap<size_t> varCount;
+  // The max. number of local blocks that are alive at the same time
+  TypeMap<size_t> maxLiveLocalCount;
+  // Indices of memref arguments that are never written via themselves or
+  // their views
+  std::set<unsigned> readOnlyArgs;
+  // Element types of the global blocks that may be written via memref
+  // arguments or global vars
+  llvm::DenseSet<mlir::Type> writtenGlobalTypes;
   std::map<std::string, mlir::memref::GlobalOp> usedGlobals;
 };
 
+struct IndexAnalysisResult {
+  // The max. absolute value of static dimension sizes, static tensor sizes,
+  // memref addresses, integer attributes, and constants in affine maps
+  uint64_t maxStaticValue = 0;
+  // The max. rank of shaped values having a dynamic dimension (0 if none)
+  unsigned maxDynamicRank = 0;
+  // True if index values come from arguments, casts, or arithmetic, so their
+  // range (and overflow) is not bounded by the shapes
+  bool hasUnboundedIndex = false;
+};
+
 struct AnalysisResult {
   FPAnalysisResult F32;
   FPAnalysisResult F64;
   MemRefAnalysisResult memref;
+  IndexAnalysisResult index;
   bool isElementwiseFPOps = true;
 };
 
 AnalysisResult analyze(mlir::FuncOp &fn);
+
+// Return the ops in the body of fn that values may depend on (the backward
+// slice). Since memory is not tracked precisely, if an op in the slice
+// accesses memory, every op accessing memory is in the slice.
+llvm::DenseSet<mlir::Operation *> getBackwardSlice(
+    mlir::FuncOp fn, llvm::ArrayRef<mlir::Value> values);
+// Return the backward slice of the ops in the body of fn that access memory.
+llvm::DenseSet<mlir::Operation *> getMemorySlice(mlir::FuncOp fn);
+
+// Return true if the block deallocated by op can be reused by allocations
+// after op. This holds if the operand is created by memref.alloc in the same
+// block and neither it nor its views are used after op.
+bool isBlockReusableAfter(mlir::memref::DeallocOp op);
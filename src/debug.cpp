@@ -9,6 +9,10 @@ void setVerbose(bool vb) {
   is_verbose = vb;
 }
 
+bool isVerbose() {
+  return is_verbose;
+}
+
 llvm::raw_ostream &verbose(const string &prefix) {
   dummy_ss.flush();
   dummy_str.clear();
@@ -4,5 +4,6 @@
 #include <string>
 
 void setVerbose(bool vb);
+bool isVerbose();
 
 llvm::raw_ostream &verbose(const std::string &prefix);
\ No newline at end of file
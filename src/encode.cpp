@@ -1,5 +1,6 @@
 #include "encode.h"
 #include "abstractops.h"
+#include "analysis.h"
 #include "opts.h"
 #include "utils.h"
 #include "debug.h"
@@ -504,7 +505,7 @@ void encodeOp(State &st, mlir::arith::AddIOp op, bool) {
   mlir::Value arg1 = op.getOperand(1);
 
   encodeBinaryOp(st, op, arg0, arg1, {},
-      [](auto &&a, auto &&b) { return (Expr)a + (Expr)b; });
+      [](auto &&a, auto &&b) { return a + b; });
 }
 
 template<>
@@ -513,7 +514,7 @@ void encodeOp(State &st, mlir::arith::SubIOp op, bool) {
   mlir::Value arg1 = op.getOperand(1);
 
   encodeBinaryOp(st, op, arg0, arg1, {},
-      [](auto &&a, auto &&b) { return (Expr)a - (Expr)b; });
+      [](auto &&a, auto &&b) { return a - b; });
 }
 
 template<>
@@ -522,7 +523,7 @@ void encodeOp(State &st, mlir::arith::MulIOp op, bool) {
   mlir::Value arg1 = op.getOperand(1);
 
   encodeBinaryOp(st, op, arg0, arg1, {},
-      [](auto &&a, auto &&b) { return (Expr)a * (Expr)b; });
+      [](auto &&a, auto &&b) { return a * b; });
 }
 
 template<>
@@ -1294,10 +1295,7 @@ void encodeOp(State &st, mlir::tosa::TransposeOp op, bool) {
     assert(pushed && "transpose's perms is not permutation!");
   }  
 
-  auto output = input.get(outVars);
-
-  st.regs.add(op, Tensor::mkLambda(input.getElemType(),
-                    move(dims), move(indVars), output, Expr::mkBool(true)));
+  st.regs.add(op, input.remap(move(dims), move(indVars), outVars));
 
 }
 
@@ -2067,9 +2065,7 @@ void encodeOp(State &st, mlir::tensor::ExtractSliceOp op, bool) {
     }
   }
   st.wellDefined(op, src.isFullyInitialized(), "source is initialized");
-  st.regs.add(res,
-      Tensor::mkInitializedLambda(src.getElemType(), move(dims), move(inIdxs),
-                       src.get(outIdxs)));
+  st.regs.add(res, src.remap(move(dims), move(inIdxs), outIdxs));
 }
 
 template<>
@@ -2532,6 +2528,8 @@ void encodeOp(State &st, mlir::memref::DeallocOp op, bool encodeMemWrite) {
   // See: https://mlir.llvm.org/docs/TargetLLVMIR/ , Ranked MemRef Types sec.
 
   st.m->setLivenessToFalse(srcTy.getElementType(), src.getBID());
+  if (isBlockReusableAfter(op))
+    st.m->markReusable(srcTy.getElementType(), src.getBID());
 }
 
 template<>
@@ -2552,15 +2550,16 @@ void encodeOp(State &st, mlir::memref::TensorStoreOp op, bool encodeMemWrite) {
       op.memref().getType().cast<mlir::MemRefType>(), true);
 }
 
+template<class T>
+static vector<vector<unsigned>> getReassociationGroups(const T &indices) {
+  vector<vector<unsigned>> groups;
+  for (auto &ids: indices)
+    groups.emplace_back(ids.begin(), ids.end());
+  return groups;
+}
+
 template<>
 void encodeOp(State &st, mlir::memref::ExpandShapeOp op, bool encodeMemWrite) {
-  auto srcType = op.src().getType().cast<mlir::MemRefType>();
-  auto resType = op.result().getType().cast<mlir::MemRefType>();
-
-  if (!srcType.getLayout().isIdentity() || !resType.getLayout().isIdentity())
-    throw UnsupportedException(op.getOperation(),
-      "We do not support non-identity layout memref");
-
   MemRef m = st.regs.get<MemRef>(op.src());
   // The fresh variables created by ShapedValue::getDims will be ignored
   // by the for loop below.
@@ -2600,20 +2599,17 @@ void encodeOp(State &st, mlir::memref::ExpandShapeOp op, bool encodeMemWrite) {
     newdims[unknown_dim] = orgdim.udiv(const_size);
   }
 
-  st.regs.add(op.getResult(), m.reshape(newdims));
+  auto res = m.expandShape(newdims, getReassociationGroups(indices));
+  if (!res)
+    throw UnsupportedException(op.getOperation(),
+      "Unsupported layout of the source memref");
+  st.regs.add(op.getResult(), move(*res));
   // Reshape does not look into memref's elements, so init check is not
   // necessary.
 }
 
 template<>
 void encodeOp(State &st, mlir::memref::CollapseShapeOp op, bool) {
-  auto srcType = op.src().getType().cast<mlir::MemRefType>();
-  auto resType = op.result().getType().cast<mlir::MemRefType>();
-
-  if (!srcType.getLayout().isIdentity() || !resType.getLayout().isIdentity())
-    throw UnsupportedException(op.getOperation(),
-      "We do not support non-identity layout memref");
-
   MemRef m = st.regs.get<MemRef>(op.getOperand());
   mlir::ShapedType resTy = op.getResultType();
 
@@ -2639,7 +2635,11 @@ void encodeOp(State &st, mlir::memref::CollapseShapeOp op, bool) {
 
   st.wellDefined(op, m.get1DSize() == smt::get1DSize(newDims),
       "size check");
-  st.regs.add(op.getResult(), m.reshape(newDims));
+  auto res = m.collapseShape(newDims, getReassociationGroups(reassocExprs));
+  if (!res)
+    throw UnsupportedException(op.getOperation(),
+      "Unsupported layout of the source memref");
+  st.regs.add(op.getResult(), move(*res));
   // Note: tensor_collapse_shape does not look into elements, so initialization
   // check is not necessary.
 }
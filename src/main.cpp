@@ -54,6 +54,14 @@ llvm::cl::opt<smt::SolverType> arg_solver("solver",
   llvm::cl::cat(MlirTvCategory)
 );
 
+llvm::cl::opt<string> arg_smt_tactic("smt-tactic",
+  llvm::cl::desc("Z3 tactic pipeline used for SMT queries: 'default', 'preset'"
+                 " (built-in pipeline for each logic), or comma-separated"
+                 " tactic names such as 'simplify,solve-eqs,bit-blast,sat'"
+                 " (default=default)"),
+  llvm::cl::init("default"), llvm::cl::value_desc("tactics"),
+  llvm::cl::cat(MlirTvCategory));
+
 llvm::cl::opt<bool> arg_verbose("verbose",
   llvm::cl::desc("Be verbose about what's going on"), llvm::cl::Hidden,
   llvm::cl::init(false),
@@ -94,6 +102,17 @@ int main(int argc, char* argv[]) {
   smt::setTimeout(arg_smt_to.getValue());
   if (arg_solver.getValue() == smt::Z3)
     smt::useZ3();
+  if (arg_smt_tactic.getValue() != "default" &&
+      arg_solver.getValue() != smt::Z3) {
+    llvm::errs() << "-smt-tactic is supported only with -solver=Z3!"
+                    " aborting..\n";
+    return 1;
+  }
+  if (!smt::setTactic(arg_smt_tactic.getValue())) {
+    llvm::errs() << "Unknown tactic in '" << arg_smt_tactic.getValue()
+                 << "'! aborting..\n";
+    return 1;
+  }
   if (arg_solver.getValue() == smt::CVC5) {
 #ifdef SOLVER_CVC5
     smt::useCVC5();
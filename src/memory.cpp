@@ -187,6 +187,7 @@ Memory::Memory(const TypeMap<size_t> &numGlobalBlocksPerType,
     numelems.insert({elemTy, move(newNumElems)});
     liveness.insert({elemTy, move(newLiveness)});
     createdByAllocs.insert({elemTy, move(newCreatedByAllocs)});
+    writeLogs.insert({elemTy, vector<vector<Write>>(numBlks)});
   }
 
   assert(addedGlobalVars == globals.size());
@@ -202,13 +203,26 @@ T Memory::itebid(mlir::Type elemTy, const Expr &bid, function<T(unsigned)> fn)
   if (bid.isUInt(const_bid))
     return fn(const_bid);
 
-  const unsigned bits = bid.sort().bitwidth();
-
-  T expr = fn(0);
-  for (unsigned i = 1; i < getNumBlocks(elemTy); i ++)
-    expr = T::mkIte(bid == Expr::mkBV(i, bits), fn(i), expr);
+  // Build a balanced decision tree over the bits of bid, so that its depth is
+  // log2(# blocks) rather than # blocks.
+  // select(lo, w) returns the block among [lo, lo + 2^w) that bid points to.
+  // If bid is larger than the last block id, any block can be returned
+  // because such bid is never dereferenced.
+  const unsigned numBlocks = getNumBlocks(elemTy);
+  function<T(unsigned, unsigned)> select = [&](unsigned lo, unsigned w) -> T {
+    if (w == 0)
+      return fn(lo);
+
+    unsigned mid = lo + (1u << (w - 1));
+    if (mid >= numBlocks)
+      return select(lo, w - 1);
+
+    auto bit = bid.extract(w - 1, w - 1);
+    return T::mkIte(bit == Expr::mkBV(1, 1), select(mid, w - 1),
+        select(lo, w - 1));
+  };
 
-  return expr;
+  return select(0, min(ulog2(numBlocks), bid.sort().bitwidth()));
 }
 
 template<>
@@ -224,9 +238,10 @@ pair<Expr, AccessInfo> Memory::itebid<pair<Expr, AccessInfo>>(
 void Memory::update(
     mlir::Type elemTy, const Expr &bid,
     function<Expr*(unsigned)> getExprToUpdate,
-    function<Expr(unsigned)> getUpdatedValue) const {
+    function<Expr(unsigned)> getUpdatedValue) {
   assert(getNumBlocks(elemTy) > 0);
   assert(bid.sort().isBV() && bid.sort().bitwidth() == getBIDBits());
+  markWritten(elemTy, bid);
 
   uint64_t const_bid;
   if (bid.isUInt(const_bid)) {
@@ -234,34 +249,211 @@ void Memory::update(
     return;
   }
 
+  // Each block is a separate term, so an update via a symbolic bid still
+  // guards every block of the type with bid == i. Only reads (itebid) select
+  // the block in log2(# blocks) depth.
   const unsigned bits = getBIDBits();
   for (unsigned i = 0; i < getNumBlocks(elemTy); ++i) {
     Expr *expr = getExprToUpdate(i);
     assert(expr);
-    *expr = Expr::mkIte(bid == Expr::mkBV(i, bits), getUpdatedValue(i), *expr);
+    auto updated = getUpdatedValue(i);
+    // Don't wrap the block with an ite if its value does not change.
+    if (updated.isIdentical(*expr))
+      continue;
+    *expr = Expr::mkIte(bid == Expr::mkBV(i, bits), updated, *expr);
   }
 }
 
+// Is a <= b always true?
+static bool isAlwaysULE(const Expr &a, const Expr &b) {
+  uint64_t ca, cb;
+  if (a.isUInt(ca) && b.isUInt(cb))
+    return ca <= cb;
+  return a.isIdentical(b) || a.ule(b).simplify().isTrue();
+}
+
+void Memory::markWritten(mlir::Type elemTy, const Expr &bid) {
+  auto &blocks = writtenBlocks[elemTy];
+  uint64_t const_bid;
+  if (bid.isUInt(const_bid)) {
+    blocks.insert(const_bid);
+    return;
+  }
+
+  for (unsigned i = 0; i < getNumBlocks(elemTy); ++i)
+    blocks.insert(i);
+}
+
+bool Memory::mayBeWritten(mlir::Type elemTy, unsigned ubid) const {
+  auto itr = writtenBlocks.find(elemTy);
+  return itr != writtenBlocks.end() && itr->second.count(ubid);
+}
+
+void Memory::logWrite(mlir::Type elemTy, const Expr &bid, Write w) {
+  markWritten(elemTy, bid);
+  uint64_t const_bid;
+  if (bid.isUInt(const_bid)) {
+    logWrite(elemTy, const_bid, w);
+    return;
+  }
+
+  // As in update(), a write via a symbolic bid goes to the log of every
+  // block of the type.
+  auto guard = w.guard;
+  for (unsigned i = 0; i < getNumBlocks(elemTy); ++i) {
+    w.guard = guard & (bid == mkBID(i));
+    logWrite(elemTy, i, w);
+  }
+}
+
+void Memory::logWrite(mlir::Type elemTy, unsigned ubid, const Write &w) {
+  auto &log = writeLogs.find(elemTy)->second[ubid];
+  if (w.guard.isFalse())
+    return;
+
+  if (w.guard.isTrue()) {
+    uint64_t low;
+    auto &numelem = numelems.find(elemTy)->second[ubid];
+    if (w.low.isUInt(low) && low == 0 &&
+        (w.size == numelem).simplify().isTrue()) {
+      // The store overwrites the whole block.
+      arrays.find(elemTy)->second[ubid] = w.isArray ? w.value :
+          Expr::mkSplatArray(Index::sort(), w.value);
+      initialized.find(elemTy)->second[ubid] =
+          Expr::mkSplatArray(Index::sort(), Expr::mkBool(true));
+      log.clear();
+      return;
+    }
+
+    // Drop the stores that are shadowed by w.
+    log.erase(remove_if(log.begin(), log.end(), [&w](const Write &w2) {
+      return isAlwaysULE(w.low, w2.low) &&
+          isAlwaysULE(w2.low + w2.size, w.low + w.size);
+    }), log.end());
+  }
+  log.push_back(w);
+}
+
+static Expr writtenValue(const Expr &idx, const Expr &low, const Expr &value,
+    bool isArray) {
+  return isArray ? value.select(idx - low) : value;
+}
+
+static bool isSingleElem(const Expr &size) {
+  uint64_t n;
+  return size.isUInt(n) && n == 1;
+}
+
+static Expr isWrittenAt(const Expr &idx, const Expr &low, const Expr &size) {
+  if (isSingleElem(size))
+    return idx == low;
+  return (idx - low).ult(size);
+}
+
+Expr Memory::getArray(mlir::Type elemTy, unsigned ubid) const {
+  Expr arr = arrays.find(elemTy)->second[ubid];
+  for (auto &w: writeLogs.find(elemTy)->second[ubid]) {
+    if (!w.isArray && isSingleElem(w.size)) {
+      arr = Expr::mkIte(w.guard, arr.store(w.low, w.value), arr);
+      continue;
+    }
+
+    auto idx = Index::var("idx", VarType::BOUND);
+    Expr cond = w.guard & isWrittenAt(idx, w.low, w.size);
+    arr = Expr::mkLambda(idx, Expr::mkIte(cond,
+        writtenValue(idx, w.low, w.value, w.isArray), arr.select(idx)));
+  }
+  return arr;
+}
+
+Expr Memory::getInitialized(mlir::Type elemTy, unsigned ubid) const {
+  Expr init = initialized.find(elemTy)->second[ubid];
+  Expr trueVal = Expr::mkBool(true);
+  for (auto &w: writeLogs.find(elemTy)->second[ubid]) {
+    if (isSingleElem(w.size)) {
+      init = Expr::mkIte(w.guard, init.store(w.low, trueVal), init);
+      continue;
+    }
+
+    auto idx = Index::var("idx", VarType::BOUND);
+    Expr cond = w.guard & isWrittenAt(idx, w.low, w.size);
+    init = Expr::mkLambda(idx, cond | init.select(idx));
+  }
+  return init;
+}
+
+Expr Memory::selectArray(mlir::Type elemTy, unsigned ubid, const Expr &idx)
+    const {
+  Expr v = arrays.find(elemTy)->second[ubid].select(idx);
+  for (auto &w: writeLogs.find(elemTy)->second[ubid])
+    v = Expr::mkIte(w.guard & isWrittenAt(idx, w.low, w.size),
+        writtenValue(idx, w.low, w.value, w.isArray), v);
+  return v;
+}
+
+Expr Memory::selectInitialized(mlir::Type elemTy, unsigned ubid,
+    const Expr &idx) const {
+  Expr v = initialized.find(elemTy)->second[ubid].select(idx);
+  for (auto &w: writeLogs.find(elemTy)->second[ubid])
+    v = (w.guard & isWrittenAt(idx, w.low, w.size)) | v;
+  return v;
+}
+
+void Memory::flushWrites(mlir::Type elemTy, unsigned ubid) {
+  auto &log = writeLogs.find(elemTy)->second[ubid];
+  if (log.empty())
+    return;
+
+  arrays.find(elemTy)->second[ubid] = getArray(elemTy, ubid);
+  initialized.find(elemTy)->second[ubid] = getInitialized(elemTy, ubid);
+  log.clear();
+}
+
 Expr Memory::addLocalBlock(
     const Expr &numelem, mlir::Type elemTy, const Expr &writable,
     bool createdByAlloc) {
-  auto bid = getNumBlocks(elemTy);
-  if (bid >= getNumGlobalBlocks(elemTy) + getMaxNumLocalBlocks(elemTy))
-    throw UnsupportedException("Too many local blocks");
+  auto &reusable = reusableBlocks[elemTy];
+  bool reuse = !reusable.empty();
+  unsigned bid;
+  if (reuse) {
+    bid = reusable.back();
+    reusable.pop_back();
+    verbose("memory") << "Reusing local block " << bid << " of type "
+        << elemTy << "\n";
+  } else {
+    bid = getNumBlocks(elemTy);
+    if (bid >= getNumGlobalBlocks(elemTy) + getMaxNumLocalBlocks(elemTy))
+      throw UnsupportedException("Too many local blocks");
+  }
 
   auto suffix = [&](const string &s) {
     return s + "#local-" + to_string(bid) + (isSrc ? "_src" : "_tgt");
   };
 
-  arrays[elemTy].push_back(Expr::mkVar(
-      Sort::arraySort(Index::sort(), *convertPrimitiveTypeToSort(elemTy)),
-      suffix("array").c_str()));
-  initialized[elemTy].push_back(
-      Expr::mkSplatArray(Index::sort(), Expr::mkBool(false)));
-  writables[elemTy].push_back(writable);
-  numelems[elemTy].push_back(numelem);
-  liveness[elemTy].push_back(Expr::mkBool(true));
-  createdByAllocs[elemTy].push_back(Expr::mkBool(createdByAlloc));
+  auto arrSort =
+      Sort::arraySort(Index::sort(), *convertPrimitiveTypeToSort(elemTy));
+  // A reused block must not share the array of its previous lifetime.
+  auto arr = reuse ? Expr::mkFreshVar(arrSort, suffix("array")) :
+      Expr::mkVar(arrSort, suffix("array").c_str());
+  auto init = Expr::mkSplatArray(Index::sort(), Expr::mkBool(false));
+
+  if (reuse) {
+    arrays[elemTy][bid] = move(arr);
+    initialized[elemTy][bid] = move(init);
+    writables[elemTy][bid] = writable;
+    numelems[elemTy][bid] = numelem;
+    liveness[elemTy][bid] = Expr::mkBool(true);
+    createdByAllocs[elemTy][bid] = Expr::mkBool(createdByAlloc);
+    writeLogs[elemTy][bid].clear();
+  } else {
+    arrays[elemTy].push_back(move(arr));
+    initialized[elemTy].push_back(move(init));
+    writables[elemTy].push_back(writable);
+    numelems[elemTy].push_back(numelem);
+    liveness[elemTy].push_back(Expr::mkBool(true));
+    createdByAllocs[elemTy].push_back(Expr::mkBool(createdByAlloc));
+    writeLogs[elemTy].emplace_back();
+  }
   return Expr::mkBV(bid, bidBits);
 }
 
@@ -306,6 +498,14 @@ void Memory::setLivenessToFalse(mlir::Type elemTy, const Expr &bid) {
       [&](auto) { return Expr::mkBool(false); });
 }
 
+void Memory::markReusable(mlir::Type elemTy, const Expr &bid) {
+  uint64_t ubid;
+  [[maybe_unused]] bool isConst = bid.isUInt(ubid);
+  assert(isConst && "The bid of a reusable block must be a constant");
+  assert(ubid >= getNumGlobalBlocks(elemTy) && "Not a local block");
+  reusableBlocks[elemTy].push_back(ubid);
+}
+
 Expr Memory::getLiveness(mlir::Type elemTy, const Expr &bid) const {
   return itebid<Expr>(elemTy, bid, [&](auto ubid) {
       return liveness.find(elemTy)->second[ubid]; });
@@ -319,7 +519,7 @@ Expr Memory::isCreatedByAlloc(mlir::Type elemTy, const Expr &bid) const {
 Expr Memory::isInitialized(mlir::Type elemTy,
     const Expr &bid, const Expr &ofs) const {
   return itebid<Expr>(elemTy, bid, [&](auto ubid) {
-      return initialized.find(elemTy)->second[ubid].select(ofs); });
+      return selectInitialized(elemTy, ubid, ofs); });
 }
 
 AccessInfo Memory::getInfo(
@@ -348,15 +548,10 @@ AccessInfo Memory::getInfo(
 
 AccessInfo Memory::store(mlir::Type elemTy, const Expr &val,
     const Expr &bid, const Expr &idx) {
-  update(elemTy, bid, [&](auto ubid) {
-        return &arrays.find(elemTy)->second[ubid]; },
-      [&](auto ubid) {
-        return arrays.find(elemTy)->second[ubid].store(idx, val); });
-  update(elemTy, bid, [&](auto ubid) {
-        return &initialized.find(elemTy)->second[ubid]; },
-      [&](auto ubid) {
-        return initialized.find(elemTy)->second[ubid]
-          .store(idx, Expr::mkBool(true)); });
+  logWrite(elemTy, bid, {
+    .guard = Expr::mkBool(true), .low = idx, .size = Index(1), .value = val,
+    .isArray = false
+  });
 
   return getInfo(elemTy, bid, idx);
 }
@@ -364,33 +559,10 @@ AccessInfo Memory::store(mlir::Type elemTy, const Expr &val,
 AccessInfo Memory::storeArray(
     mlir::Type elemTy, const Expr &arr, const Expr &bid, const Expr &offset,
     const Expr &size) {
-  auto low = offset;
-  auto high = offset + size - 1;
-  auto idx = Index::var("idx", VarType::BOUND);
-  auto arrayVal = arr.select((Expr)idx - low);
-
-  update(elemTy, bid, [&](auto ubid) {
-      return &arrays.find(elemTy)->second[ubid]; },
-    [&](auto ubid) {
-      uint64_t offset_const;
-      const Expr &size_bid = this->numelems.find(elemTy)->second[ubid];
-      if (offset.isUInt(offset_const) && offset_const == 0 &&
-          (size == size_bid).isTrue())
-        // Simply replace the previous value
-        return arr;
-
-      auto currentVal = arrays.find(elemTy)->second[ubid].select(idx);
-      Expr cond = low.ule(idx) & ((Expr)idx).ule(high);
-      return Expr::mkLambda(idx, Expr::mkIte(cond, arrayVal, currentVal));
-    });
-  update(elemTy, bid, [&](auto ubid) {
-      return &initialized.find(elemTy)->second[ubid]; },
-    [&](auto ubid) {
-      auto currentVal = initialized.find(elemTy)->second[ubid].select(idx);
-      Expr cond = low.ule(idx) & ((Expr)idx).ule(high);
-      Expr trueVal = Expr::mkBool(true);
-      return Expr::mkLambda(idx, Expr::mkIte(cond, trueVal, currentVal));
-    });
+  logWrite(elemTy, bid, {
+    .guard = Expr::mkBool(true), .low = offset, .size = size, .value = arr,
+    .isArray = true
+  });
 
   return getInfo(elemTy, bid, offset, size);
 }
@@ -411,6 +583,15 @@ void Memory::freshArray(
   auto init = Expr::mkFreshVar(initSort, suffix("initialized"));
   auto arr = Expr::mkFreshVar(arrSort, suffix("array"));
 
+  uint64_t const_bid;
+  if (bid.isUInt(const_bid))
+    // The pending stores are overwritten by the fresh array.
+    writeLogs.find(elemTy)->second[const_bid].clear();
+  else {
+    for (unsigned i = 0; i < getNumBlocks(elemTy); ++i)
+      flushWrites(elemTy, i);
+  }
+
   update(elemTy, bid, [&](auto ubid) {
         return &arrays.find(elemTy)->second[ubid]; },
       [&arr](auto ubid) { return arr; });
@@ -423,7 +604,7 @@ pair<Expr, AccessInfo> Memory::load(
     mlir::Type elemTy, const Expr &bid, const Expr &idx) const {
   return itebid<pair<Expr, AccessInfo>>(elemTy, bid,
       [&](unsigned ubid) -> pair<Expr, AccessInfo> {
-    return {arrays.find(elemTy)->second[ubid].select(idx),
+    return {selectArray(elemTy, ubid, idx),
       getInfo(elemTy, mkBID(ubid), idx)};
   });
 }
@@ -433,7 +614,7 @@ pair<Expr, AccessInfo> Memory::loadArray(
   return itebid<pair<Expr, AccessInfo>>(elemTy, bid,
       [&](unsigned ubid) -> pair<Expr, AccessInfo>{
     Expr idx0 = Index::var("arridx", VarType::BOUND);
-    Expr arr = arrays.find(elemTy)->second[ubid];
+    Expr arr = getArray(elemTy, ubid);
     auto l = Expr::mkLambda({idx0}, arr.select(idx0 + ofs));
     return {l, getInfo(elemTy, mkBID(ubid), ofs, size)};
   });
@@ -468,9 +649,12 @@ Memory::refines(const Memory &other) const {
     auto bid = Expr::mkFreshVar(Sort::bvSort(bidBits), "bid_" + to_string(ty));
     auto offset = Index::var("offset_" + to_string(ty), VarType::FRESH);
 
-    for (unsigned i = 0; i < numblks; i ++)
+    for (unsigned i = 0; i < numblks; i ++) {
+      if (!mayBeWritten(ty, i) && !other.mayBeWritten(ty, i))
+        continue;
       refinement = Expr::mkIte(
           bid == Expr::mkBV(i, bidBits), refinesBlk(ty, i, offset), refinement);
+    }
 
     vector<Expr> params{bid, offset};
     ElemTy elem = {move(refinement), move(params)};
@@ -479,3 +663,39 @@ Memory::refines(const Memory &other) const {
 
   return tmap;
 }
+
+vector<Expr> Memory::splitRefinement(const Memory &other, mlir::Type elemTy,
+    const vector<Expr> &params, unsigned maxOffsetSplits) const {
+  assert(params.size() == 2);
+  auto &bid = params[0];
+  auto &offset = params[1];
+  auto numblks = getNumGlobalBlocks(elemTy);
+  auto &srcNumElems = other.numelems.find(elemTy)->second;
+
+  vector<Expr> cubes;
+  for (unsigned i = 0; i < numblks; ++i) {
+    if (!mayBeWritten(elemTy, i) && !other.mayBeWritten(elemTy, i))
+      continue;
+
+    auto isBid = bid == mkBID(i);
+    uint64_t n;
+    if (maxOffsetSplits <= 1 || !srcNumElems[i].simplify().isUInt(n) ||
+        n <= 1) {
+      cubes.push_back(isBid);
+      continue;
+    }
+
+    // Split [0, n) into ranges of almost equal sizes.
+    uint64_t numRanges = min((uint64_t)maxOffsetSplits, n);
+    uint64_t lo = 0;
+    for (uint64_t r = 0; r < numRanges; ++r) {
+      uint64_t hi = n * (r + 1) / numRanges;
+      cubes.push_back(isBid & offset.uge(lo) & offset.ult(hi));
+      lo = hi;
+    }
+  }
+
+  verbose("splitRefinement") << to_string(elemTy) << ": " << cubes.size()
+      << " cubes\n";
+  return cubes;
+}
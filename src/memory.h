@@ -5,6 +5,7 @@
 #include "utils.h"
 
 #include <algorithm>
+#include <set>
 #include <vector>
 
 struct AccessInfo {
@@ -50,6 +51,24 @@ class Memory {
   // (Element type, bid) of global variables.
   std::map<std::string, std::pair<mlir::Type, unsigned>> globalVarBids;
 
+  // A store to a block that is not applied to its array yet.
+  struct Write {
+    smt::Expr guard; // The store happens only if guard holds.
+    smt::Expr low, size; // The stored range is [low, low + size).
+    smt::Expr value; // An element, or an array whose 0th element is at low
+    bool isArray;
+  };
+  // element type -> vector<stores to the block, from the oldest one>
+  // Stores are materialized into arrays and initialized only when a load
+  // needs the contents. A store drops the earlier ones that it shadows.
+  TypeMap<std::vector<std::vector<Write>>> writeLogs;
+
+  // element type -> vector<dead local blocks that addLocalBlock can reuse>
+  TypeMap<std::vector<unsigned>> reusableBlocks;
+
+  // element type -> blocks whose contents or attributes may have been updated
+  TypeMap<std::set<unsigned>> writtenBlocks;
+
 public:
   Memory(const TypeMap<size_t> &numGlobalBlocksPerType,
          const TypeMap<size_t> &maxNumLocalBlocksPerType,
@@ -77,6 +96,7 @@ public:
   smt::Expr isLocalBlock(mlir::Type elemType, const smt::Expr &bid) const;
 
   // Returns: (the newly created block's id)
+  // If there is a reusable block, its id is returned.
   smt::Expr addLocalBlock(const smt::Expr &numelem, mlir::Type elemTy,
       const smt::Expr &writable, bool createdByAlloc);
 
@@ -96,6 +116,9 @@ public:
 
   // Mark memblock's liveness to false.
   void setLivenessToFalse(mlir::Type elemTy, const smt::Expr &bid);
+  // Let addLocalBlock reuse the dead local block (elemTy, bid).
+  // The caller must guarantee that the block is no longer accessed.
+  void markReusable(mlir::Type elemTy, const smt::Expr &bid);
   // Get the liveness flag
   smt::Expr getLiveness(mlir::Type elemTy, const smt::Expr &bid) const;
 
@@ -122,11 +145,25 @@ public:
       mlir::Type elemTy, const smt::Expr &bid, const smt::Expr &idx,
       const smt::Expr &size);
 
+  // Return false if the block is never updated since the initial state.
+  bool mayBeWritten(mlir::Type elemTy, unsigned ubid) const;
+
   // Encode the refinement relation between src (other) and tgt (this) memory
   // for each element type.
   // Memory refinement is defined using global memory blocks only.
+  // Blocks that are updated by neither memory trivially satisfy refinement
+  // and are omitted.
   TypeMap<std::pair<smt::Expr, std::vector<smt::Expr>>>
       refines(const Memory &other) const;
+  // Split the memory refinement of elemTy into cubes over the bid and offset
+  // variables (params) of refines().
+  // There is one cube per global block id that may be written. If the number
+  // of elements of a block is a constant, its offset range is further split
+  // into at most maxOffsetSplits ranges. Offsets out of the range need not be
+  // covered because refinement trivially holds for them.
+  std::vector<smt::Expr> splitRefinement(const Memory &other,
+      mlir::Type elemTy, const std::vector<smt::Expr> &params,
+      unsigned maxOffsetSplits) const;
 
   Memory *clone() const { return new Memory(*this); }
 
@@ -138,7 +175,23 @@ private:
   void update(
       mlir::Type elemTy, const smt::Expr &bid,
       std::function<smt::Expr*(unsigned)> exprToUpdate, // bid -> ptr to expr
-      std::function<smt::Expr(unsigned)> updatedValue) const; // bid -> updated
+      std::function<smt::Expr(unsigned)> updatedValue); // bid -> updated
+
+  // Record that the blocks bid may point to are updated.
+  void markWritten(mlir::Type elemTy, const smt::Expr &bid);
+  // Append w to the write logs of the blocks that bid may point to.
+  void logWrite(mlir::Type elemTy, const smt::Expr &bid, Write w);
+  void logWrite(mlir::Type elemTy, unsigned ubid, const Write &w);
+  // Apply the write log of the block to its element / initialized array.
+  smt::Expr getArray(mlir::Type elemTy, unsigned ubid) const;
+  smt::Expr getInitialized(mlir::Type elemTy, unsigned ubid) const;
+  // Load through the write log without materializing the whole array.
+  smt::Expr selectArray(mlir::Type elemTy, unsigned ubid, const smt::Expr &idx)
+      const;
+  smt::Expr selectInitialized(mlir::Type elemTy, unsigned ubid,
+      const smt::Expr &idx) const;
+  // Materialize the write log of the block and clear it.
+  void flushWrites(mlir::Type elemTy, unsigned ubid);
 
   AccessInfo getInfo(mlir::Type elemTy, const smt::Expr &bid,
       const smt::Expr &ofs) const;
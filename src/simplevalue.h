@@ -17,15 +17,26 @@ enum class VarType {
 };
 
 class Integer {
-  smt::Expr e;
+  // The value if it is known during encoding and fits in 64 bits.
+  // Arithmetic on known values is folded without creating solver terms, and
+  // e is created only when the Integer is converted to smt::Expr.
+  std::optional<uint64_t> known;
+  unsigned bw = 0;
+  mutable std::optional<smt::Expr> e;
 
 public:
-  Integer(const smt::Expr &e): e(e) { this->e.unlockOps(); }
+  Integer(const smt::Expr &e);
   Integer(int64_t i, unsigned bw);
   Integer(const llvm::APInt &api);
 
-  operator smt::Expr() const { return e; }
-  unsigned bitwidth() { return e.bitwidth(); }
+  operator smt::Expr() const;
+  unsigned bitwidth() const { return known ? bw : e->bitwidth(); }
+  std::optional<uint64_t> asUInt() const { return known; }
+
+  Integer operator+(const Integer &b) const;
+  Integer operator-(const Integer &b) const;
+  Integer operator*(const Integer &b) const;
+  smt::Expr operator==(const Integer &b) const;
 
   static smt::Sort sort(unsigned bw);
   static Integer var(std::string &&name, unsigned bw, VarType vty);
@@ -40,25 +51,38 @@ public:
 };
 
 class Index {
-  smt::Expr e;
+  // The value if it is known during encoding. Arithmetic and comparisons on
+  // known values are folded without creating solver terms, and e is created
+  // only when the Index is converted to smt::Expr.
+  std::optional<uint64_t> known;
+  mutable std::optional<smt::Expr> e;
+
+  static Index fromKnown(uint64_t v);
 
 public:
-  static const unsigned BITS = 32;
+  static constexpr unsigned DEFAULT_BITS = 32;
+  // The bitwidth of index values. It is chosen per function pair before
+  // encoding (see vcgen.cpp).
+  static inline unsigned BITS = DEFAULT_BITS;
 
   Index(unsigned);
-  Index(const smt::Expr &e): e(e) { this->e.unlockOps(); }
-  Index(smt::Expr &&e): e(std::move(e)) { this->e.unlockOps(); }
-
-  operator smt::Expr() const { return e; }
-  Index operator*(const Index &b) const { return Index(e * b.e); }
-  Index operator+(const Index &b) const { return Index(e + b.e); }
-  Index operator-(const Index &b) const { return Index(e - b.e); }
-  smt::Expr operator==(const Index &b) const { return e == b.e; }
+  Index(const smt::Expr &e);
+  Index(smt::Expr &&e);
+
+  operator smt::Expr() const;
+  std::optional<uint64_t> asUInt() const { return known; }
+
+  Index operator*(const Index &b) const;
+  Index operator+(const Index &b) const;
+  Index operator-(const Index &b) const;
+  Index udiv(const Index &b) const;
+  Index urem(const Index &b) const;
+  smt::Expr operator==(const Index &b) const;
+  smt::Expr ult(const Index &b) const;
   Index ofs(int i) const {
-    uint64_t v;
-    if (e.isUInt(v))
-      return Index(v + i);
-    return Index(e + i);
+    if (known)
+      return fromKnown(*known + i);
+    return Index((smt::Expr)*this + i);
   }
 
   static smt::Sort sort();
@@ -67,12 +91,12 @@ public:
   static Index var(std::string &&name, enum VarType);
   // Creates N variables that must be bound to forall/lambda/exists.
   static std::vector<smt::Expr> boundIndexVars(unsigned N);
-  static Index fromInteger(const Integer &i) { return Index((smt::Expr)i); }
+  static Index fromInteger(const Integer &i);
 
   friend llvm::raw_ostream& operator<<(llvm::raw_ostream&, const Index &);
   // (refinement, unbound variables used in the refinement formula)
   std::pair<smt::Expr, std::vector<smt::Expr>> refines(
       const Index &other) const;
   Index eval(smt::Model m) const;
-  Integer asInteger() const { return Integer(e); }
+  Integer asInteger() const;
 };
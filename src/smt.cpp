@@ -2,6 +2,12 @@
 #include "smt.h"
 #include "smtmatchers.h"
 #include "utils.h"
+#include "debug.h"
+#include <mutex>
+#include <set>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
 
 #ifdef SOLVER_Z3
 #define SET_Z3(e, v) (e).setZ3(v)
@@ -69,6 +75,8 @@ private:
 
 public:
   uint64_t timeout_ms;
+  // The Z3 tactic pipeline (see setTactic)
+  string tactic;
 
   Context() {
     fresh_var_counter = 0;
@@ -83,11 +91,10 @@ public:
 #endif
 #ifdef SOLVER_CVC5
   void useCVC5() {
+    // This solver only creates and simplifies terms. Queries are solved by
+    // fresh solvers (see CVC5Query) that use the logic of each query.
     this->cvc5.emplace();
-    // TODO: Conditionally use HO_AUFBV
     this->cvc5->setLogic("HO_ALL");
-    this->cvc5->setOption("tlimit", to_string(timeout_ms));
-    this->cvc5->setOption("produce-models", "true");
   }
 
   optional<cvc5::api::Term> getNamedTerm(string_view name) {
@@ -119,12 +126,14 @@ vector<Expr> from1DIdx(
     const vector<Expr> &dims) {
   assert(dims.size() > 0);
   vector<Expr> idxs;
+  Index idx = idx1d;
 
   // Start from the lowest dimension
   for (size_t ii = dims.size(); ii > 0; --ii) {
     size_t i = ii - 1;
-    idxs.emplace_back(i == 0 ? idx1d : idx1d.urem(dims[i]));
-    idx1d = idx1d.udiv(dims[i]);
+    Index dim = dims[i];
+    idxs.emplace_back(i == 0 ? idx : idx.urem(dim));
+    idx = idx.udiv(dim);
   }
 
   reverse(idxs.begin(), idxs.end());
@@ -132,14 +141,13 @@ vector<Expr> from1DIdx(
 }
 
 Expr get1DSize(const vector<Expr> &dims) {
-  Expr szaccml = Index::one();
-  for (auto &d: dims) {
-    assert(d.sort().isBV());
+  Index szaccml = Index::one();
+  for (auto &d: dims)
     szaccml = szaccml * d;
-  }
 
-  szaccml = szaccml.simplify();
-  return szaccml;
+  if (szaccml.asUInt())
+    return szaccml;
+  return ((Expr)szaccml).simplify();
 }
 
 vector<Expr> simplifyList(const vector<Expr> &exprs) {
@@ -165,13 +173,14 @@ Expr to1DIdx(
     return Index::zero();
 
   assert(idxs.size() == dims.size());
-  auto idx = idxs[0];
+  Index idx = idxs[0];
 
-  for (size_t i = 1; i < idxs.size(); ++i) {
+  for (size_t i = 1; i < idxs.size(); ++i)
     idx = idx * dims[i] + idxs[i];
-  }
-  idx = idx.simplify();
-  return idx;
+
+  if (idx.asUInt())
+    return idx;
+  return ((Expr)idx).simplify();
 }
 
 Expr fitsInDims(
@@ -181,7 +190,7 @@ Expr fitsInDims(
 
   Expr cond = Expr::mkBool(true);
   for (size_t i = 0; i < idxs.size(); ++i)
-    cond = cond & (idxs[i].ult(sizes[i]));
+    cond = cond & Index(idxs[i]).ult(sizes[i]);
   return cond;
 }
 
@@ -311,6 +320,249 @@ Expr Expr::simplify() const {
   return e;
 }
 
+#ifdef SOLVER_Z3
+// A map from the id of a term to (the term, its rewritten term).
+// The term is kept alive so that Z3 does not reuse its id for another term.
+using Z3RewriteCache = unordered_map<unsigned, pair<z3::expr, z3::expr>>;
+
+// Does e have a de Bruijn variable that is not bound within e, assuming
+// that e is under numBound binders?
+static bool hasLooseVarZ3(const z3::expr &e, unsigned numBound,
+    set<pair<unsigned, unsigned>> &visited) {
+  if (!visited.emplace(e.id(), numBound).second)
+    return false;
+
+  if (e.is_var())
+    return Z3_get_index_value(e.ctx(), e) >= numBound;
+  if (e.is_quantifier())
+    return hasLooseVarZ3(e.body(),
+        numBound + Z3_get_quantifier_num_bound(e.ctx(), e), visited);
+  if (e.is_app()) {
+    for (unsigned i = 0; i < e.num_args(); ++i)
+      if (hasLooseVarZ3(e.arg(i), numBound, visited))
+        return true;
+  }
+  return false;
+}
+
+static z3::expr betaReduceZ3(const z3::expr &e, Z3RewriteCache &cache) {
+  auto itr = cache.find(e.id());
+  if (itr != cache.end())
+    return itr->second.second;
+
+  auto &ctx = e.ctx();
+  z3::expr res = e;
+  if (e.is_quantifier()) {
+    auto body = betaReduceZ3(e.body(), cache);
+    bool isUnaryLambda = Z3_is_lambda(ctx, e) &&
+        Z3_get_quantifier_num_bound(ctx, e) == 1;
+    if (isUnaryLambda && body.is_app() &&
+        body.decl().decl_kind() == Z3_OP_SELECT && body.num_args() == 2 &&
+        body.arg(1).is_var() && Z3_get_index_value(ctx, body.arg(1)) == 0 &&
+        body.arg(0).is_const()) {
+      // lambda i. a[i] -> a
+      res = body.arg(0);
+    } else {
+      Z3_ast newBody = body;
+      res = z3::expr(ctx, Z3_update_term(ctx, e, 1, &newBody));
+    }
+
+  } else if (e.is_app() && e.num_args() > 0) {
+    vector<z3::expr> args;
+    vector<Z3_ast> argAsts;
+    for (unsigned i = 0; i < e.num_args(); ++i) {
+      args.push_back(betaReduceZ3(e.arg(i), cache));
+      argAsts.push_back(args.back());
+    }
+
+    auto &arr = args[0];
+    unsigned numIdxs = args.size() - 1;
+    set<pair<unsigned, unsigned>> visited;
+    if (e.decl().decl_kind() == Z3_OP_SELECT && arr.is_quantifier() &&
+        Z3_is_lambda(ctx, arr) &&
+        Z3_get_quantifier_num_bound(ctx, arr) == numIdxs &&
+        // substitute() does not shift down the variables bound outside the
+        // lambda, so such lambdas are not reduced.
+        !hasLooseVarZ3(arr.body(), numIdxs, visited)) {
+      // The last bound variable has de Bruijn index 0
+      z3::expr_vector to(ctx);
+      for (unsigned i = 0; i < numIdxs; ++i)
+        to.push_back(args[numIdxs - i]);
+      res = betaReduceZ3(arr.body().substitute(to), cache);
+
+    } else if (e.decl().decl_kind() == Z3_OP_SELECT && arr.is_app() &&
+        arr.decl().decl_kind() == Z3_OP_ITE) {
+      z3::expr_vector idxs(ctx);
+      for (unsigned i = 1; i < args.size(); ++i)
+        idxs.push_back(args[i]);
+      res = betaReduceZ3(z3::ite(arr.arg(0), z3::select(arr.arg(1), idxs),
+          z3::select(arr.arg(2), idxs)), cache);
+
+    } else {
+      res = z3::expr(ctx,
+          Z3_update_term(ctx, e, argAsts.size(), argAsts.data()));
+    }
+  }
+
+  cache.emplace(e.id(), make_pair(e, res));
+  return res;
+}
+
+// Find the upper bounds of the bound variables from the conjunction guard.
+// bounds is indexed by de Bruijn index.
+static void findBoundsZ3(
+    const z3::expr &guard, vector<optional<uint64_t>> &bounds) {
+  if (!guard.is_app())
+    return;
+
+  auto update = [&bounds](const z3::expr &var, const z3::expr &bound,
+                          uint64_t inc) {
+    uint64_t c;
+    if (!var.is_var() || !bound.is_numeral_u64(c) || c + inc < c)
+      return;
+    unsigned idx = Z3_get_index_value(var.ctx(), var);
+    if (idx < bounds.size())
+      bounds[idx] = min(bounds[idx].value_or(c + inc), c + inc);
+  };
+
+  switch (guard.decl().decl_kind()) {
+  case Z3_OP_AND:
+    for (unsigned i = 0; i < guard.num_args(); ++i)
+      findBoundsZ3(guard.arg(i), bounds);
+    break;
+  case Z3_OP_ULT: // v < c
+    update(guard.arg(0), guard.arg(1), 0);
+    break;
+  case Z3_OP_ULEQ: // v <= c
+    update(guard.arg(0), guard.arg(1), 1);
+    break;
+  case Z3_OP_NOT: { // !(c <= v)
+    auto neg = guard.arg(0);
+    if (neg.is_app() && neg.decl().decl_kind() == Z3_OP_ULEQ)
+      update(neg.arg(1), neg.arg(0), 0);
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static z3::expr expandForallsZ3(
+    const z3::expr &e, uint64_t maxInstances, unsigned &numExpanded,
+    Z3RewriteCache &cache) {
+  auto itr = cache.find(e.id());
+  if (itr != cache.end())
+    return itr->second.second;
+
+  auto &ctx = e.ctx();
+  z3::expr res = e;
+  if (e.is_quantifier()) {
+    auto body = expandForallsZ3(e.body(), maxInstances, numExpanded, cache);
+    Z3_ast newBody = body;
+    res = z3::expr(ctx, Z3_update_term(ctx, e, 1, &newBody));
+
+    unsigned numBound = Z3_get_quantifier_num_bound(ctx, e);
+    vector<optional<uint64_t>> bounds(numBound);
+    if (e.is_forall() && body.is_app() &&
+        body.decl().decl_kind() == Z3_OP_IMPLIES)
+      findBoundsZ3(body.arg(0), bounds);
+
+    uint64_t numInstances = 1;
+    for (auto &b: bounds) {
+      // Check before multiplying so that numInstances does not wrap around.
+      if (!b || (numInstances != 0 && *b > maxInstances / numInstances)) {
+        numInstances = maxInstances + 1;
+        break;
+      }
+      numInstances *= *b;
+    }
+
+    // Like betaReduceZ3, substitute() would not shift down the variables
+    // bound outside the forall.
+    set<pair<unsigned, unsigned>> visited;
+    if (e.is_forall() && numInstances <= maxInstances &&
+        !hasLooseVarZ3(body, numBound, visited)) {
+      // The bound variable whose de Bruijn index is k is the
+      // (numBound - 1 - k)-th one.
+      vector<uint64_t> vals(numBound, 0);
+      z3::expr_vector instances(ctx);
+      for (uint64_t n = 0; n < numInstances; ++n) {
+        z3::expr_vector to(ctx);
+        for (unsigned k = 0; k < numBound; ++k) {
+          z3::sort s(ctx, Z3_get_quantifier_bound_sort(
+              ctx, e, numBound - 1 - k));
+          to.push_back(ctx.bv_val(vals[k], s.bv_size()));
+        }
+        instances.push_back(body.substitute(to));
+
+        for (unsigned k = 0; k < numBound && ++vals[k] == *bounds[k]; ++k)
+          vals[k] = 0;
+      }
+      res = z3::mk_and(instances);
+      ++numExpanded;
+    }
+
+  } else if (e.is_app() && e.num_args() > 0) {
+    vector<z3::expr> args;
+    vector<Z3_ast> argAsts;
+    for (unsigned i = 0; i < e.num_args(); ++i) {
+      args.push_back(expandForallsZ3(e.arg(i), maxInstances, numExpanded,
+          cache));
+      argAsts.push_back(args.back());
+    }
+    res = z3::expr(ctx,
+        Z3_update_term(ctx, e, argAsts.size(), argAsts.data()));
+  }
+
+  cache.emplace(e.id(), make_pair(e, res));
+  return res;
+}
+
+static size_t getZ3DAGSize(const z3::expr &e) {
+  unordered_set<unsigned> visited;
+  vector<z3::expr> worklist{e};
+  while (!worklist.empty()) {
+    auto e2 = worklist.back();
+    worklist.pop_back();
+    if (!visited.insert(e2.id()).second)
+      continue;
+
+    if (e2.is_quantifier())
+      worklist.push_back(e2.body());
+    else if (e2.is_app()) {
+      for (unsigned i = 0; i < e2.num_args(); ++i)
+        worklist.push_back(e2.arg(i));
+    }
+  }
+  return visited.size();
+}
+#endif // SOLVER_Z3
+
+Expr Expr::betaReduce() const {
+  Expr e;
+  SET_Z3(e, fmap(this->z3, [](auto e) {
+    Z3RewriteCache cache;
+    return betaReduceZ3(e, cache);
+  }));
+  SET_CVC5(e, optional(this->cvc5));
+  return e;
+}
+
+Expr Expr::expandForalls(uint64_t maxInstances, unsigned &numExpanded) const {
+  Expr e;
+  SET_Z3(e, fmap(this->z3, [maxInstances, &numExpanded](auto e) {
+    Z3RewriteCache cache;
+    return expandForallsZ3(e, maxInstances, numExpanded, cache);
+  }));
+  SET_CVC5(e, optional(this->cvc5));
+  return e;
+}
+
+size_t Expr::getDAGSize() const {
+  IF_Z3_ENABLED(if (z3) return getZ3DAGSize(*z3));
+  return 0;
+}
+
 Sort Expr::sort() const {
   Sort s;
   SET_Z3(s, fmap(z3, [](auto e) { return e.get_sort(); }));
@@ -427,16 +679,21 @@ bool Expr::isVar() const {
 bool Expr::hasQuantifier() const {
 #ifdef SOLVER_Z3
   if (z3) {
-    auto e = getZ3Expr();
-    if (e.is_forall() || e.is_exists()) return true;
-    if (!e.is_app()) return false;
-
-    Z3_app a = e;
-    for (unsigned i = 0; i < Z3_get_app_num_args(*sctx.z3, a); i++) {
-      Expr newe = Expr();
-      newe.setZ3(z3::expr(*sctx.z3, Z3_get_app_arg(*sctx.z3, a, i)));
-      if (newe.hasQuantifier())
+    // Visit each node of the DAG once
+    unordered_set<unsigned> visited;
+    vector<z3::expr> worklist{*z3};
+    while (!worklist.empty()) {
+      auto e = worklist.back();
+      worklist.pop_back();
+      if (!visited.insert(e.id()).second)
+        continue;
+
+      if (e.is_forall() || e.is_exists())
         return true;
+      if (!e.is_app())
+        continue;
+      for (unsigned i = 0; i < e.num_args(); ++i)
+        worklist.push_back(e.arg(i));
     }
     return false;
   }
@@ -460,6 +717,28 @@ bool Expr::hasQuantifier() const {
   return false;
 }
 
+bool Expr::isArrayAndQuantifierFree() const {
+#ifdef SOLVER_Z3
+  if (z3) {
+    unordered_set<unsigned> visited;
+    vector<z3::expr> worklist{*z3};
+    while (!worklist.empty()) {
+      auto e = worklist.back();
+      worklist.pop_back();
+      if (!visited.insert(e.id()).second)
+        continue;
+
+      if (!e.is_app() || e.get_sort().is_array())
+        return false;
+      for (unsigned i = 0; i < e.num_args(); ++i)
+        worklist.push_back(e.arg(i));
+    }
+    return true;
+  }
+#endif // SOLVER_Z3
+  return false;
+}
+
 string Expr::getVarName() const {
   assert(isVar());
   // TODO: CVC5
@@ -1450,6 +1729,185 @@ Sort Sort::arraySort(const Sort &domain, const Sort &range) {
   return s;
 }
 
+#ifdef SOLVER_CVC5
+// ------- CVC5Query -------
+
+// cvc5 terms cannot be passed to a solver other than the one that created
+// them, so the terms are rebuilt in the destination solver.
+static cvc5::api::Sort copySort(cvc5::api::Solver &to,
+    const cvc5::api::Sort &s) {
+  if (s.isBoolean())
+    return to.getBooleanSort();
+  else if (s.isInteger())
+    return to.getIntegerSort();
+  else if (s.isBitVector())
+    return to.mkBitVectorSort(s.getBitVectorSize());
+  else if (s.isArray())
+    return to.mkArraySort(copySort(to, s.getArrayIndexSort()),
+        copySort(to, s.getArrayElementSort()));
+  else if (s.isBag())
+    return to.mkBagSort(copySort(to, s.getBagElementSort()));
+  else if (s.isFunction()) {
+    vector<cvc5::api::Sort> domain;
+    for (auto &d: s.getFunctionDomainSorts())
+      domain.push_back(copySort(to, d));
+    return to.mkFunctionSort(domain, copySort(to, s.getFunctionCodomainSort()));
+  }
+  assert(false && "Unknown cvc5 sort");
+  return to.getNullSort();
+}
+
+static cvc5::api::Term copyTerm(cvc5::api::Solver &to,
+    const cvc5::api::Term &t,
+    unordered_map<cvc5::api::Term, cvc5::api::Term> &cache) {
+  auto itr = cache.find(t);
+  if (itr != cache.end())
+    return itr->second;
+
+  cvc5::api::Term res;
+  switch (t.getKind()) {
+  case cvc5::api::CONSTANT:
+    res = to.mkConst(copySort(to, t.getSort()), t.getSymbol());
+    break;
+  case cvc5::api::VARIABLE:
+    res = t.hasSymbol() ?
+        to.mkVar(copySort(to, t.getSort()), t.getSymbol()) :
+        to.mkVar(copySort(to, t.getSort()));
+    break;
+  case cvc5::api::CONST_BOOLEAN:
+    res = to.mkBoolean(t.getBooleanValue());
+    break;
+  case cvc5::api::CONST_BITVECTOR:
+    res = to.mkBitVector(t.getSort().getBitVectorSize(),
+        t.getBitVectorValue(10), 10);
+    break;
+  case cvc5::api::CONST_RATIONAL:
+    res = to.mkInteger(t.getIntegerValue());
+    break;
+  case cvc5::api::CONST_ARRAY:
+    res = to.mkConstArray(copySort(to, t.getSort()),
+        copyTerm(to, t.getConstArrayBase(), cache));
+    break;
+  case cvc5::api::EMPTYBAG:
+    res = to.mkEmptyBag(copySort(to, t.getSort()));
+    break;
+  default: {
+    vector<cvc5::api::Term> children;
+    for (size_t i = 0; i < t.getNumChildren(); ++i)
+      children.push_back(copyTerm(to, t[i], cache));
+
+    if (!t.hasOp() || !t.getOp().isIndexed()) {
+      res = to.mkTerm(t.getKind(), children);
+      break;
+    }
+
+    auto op = t.getOp();
+    switch (op.getKind()) {
+    case cvc5::api::BITVECTOR_EXTRACT: {
+      auto [hbit, lbit] = op.getIndices<pair<uint32_t, uint32_t>>();
+      res = to.mkTerm(to.mkOp(op.getKind(), hbit, lbit), children);
+      break;
+    }
+    case cvc5::api::BITVECTOR_ZERO_EXTEND:
+    case cvc5::api::BITVECTOR_SIGN_EXTEND:
+      res = to.mkTerm(to.mkOp(op.getKind(), op.getIndices<uint32_t>()),
+          children);
+      break;
+    default:
+      assert(false && "Unknown indexed cvc5 operator");
+    }
+  }
+  }
+
+  cache.emplace(t, res);
+  return res;
+}
+
+class CVC5Query {
+private:
+  string logic;
+  // Terms asserted before the logic is decided
+  vector<cvc5::api::Term> pending;
+  bool started = false;
+  // sctx.cvc5 term -> solver term
+  unordered_map<cvc5::api::Term, cvc5::api::Term> imported;
+  // solver term -> sctx.cvc5 term
+  unordered_map<cvc5::api::Term, cvc5::api::Term> exported;
+
+  // Are lambdas or function-sorted arguments used?
+  static bool isHigherOrder(const vector<cvc5::api::Term> &terms) {
+    vector<cvc5::api::Term> worklist(terms);
+    unordered_set<cvc5::api::Term> visited;
+
+    while (!worklist.empty()) {
+      auto t = worklist.back();
+      worklist.pop_back();
+      if (!visited.insert(t).second)
+        continue;
+
+      if (t.getKind() == cvc5::api::LAMBDA)
+        return true;
+      for (size_t i = 0; i < t.getNumChildren(); ++i) {
+        auto child = t[i];
+        // The first child of APPLY_UF is the function being applied.
+        bool isCallee = t.getKind() == cvc5::api::APPLY_UF && i == 0;
+        if (!isCallee && child.getSort().isFunction())
+          return true;
+        worklist.push_back(child);
+      }
+    }
+    return false;
+  }
+
+  void start() {
+    if (started)
+      return;
+    started = true;
+
+    // Add the HO prefix only if the query needs it; first-order logics are
+    // much cheaper to set up.
+    string l = logic;
+    if (l.rfind("HO_", 0) != 0 && isHigherOrder(pending))
+      l = "HO_" + l;
+    verbose("CVC5Query") << "use logic: " << l << "\n";
+    solver.setLogic(l);
+    solver.setOption("tlimit", to_string(sctx.timeout_ms));
+    solver.setOption("produce-models", "true");
+    solver.setOption("incremental", "true");
+
+    for (auto &t: pending)
+      solver.assertFormula(importTerm(t));
+    pending.clear();
+  }
+
+public:
+  cvc5::api::Solver solver;
+
+  CVC5Query(string logic): logic(move(logic)) {}
+
+  void add(const cvc5::api::Term &t) {
+    if (started)
+      solver.assertFormula(importTerm(t));
+    else
+      pending.push_back(t);
+  }
+
+  cvc5::api::Result check() {
+    start();
+    return solver.checkSat();
+  }
+
+  cvc5::api::Term importTerm(const cvc5::api::Term &t) {
+    start();
+    return copyTerm(solver, t, imported);
+  }
+
+  cvc5::api::Term exportTerm(const cvc5::api::Term &t) {
+    return copyTerm(*sctx.cvc5, t, exported);
+  }
+};
+#endif // SOLVER_CVC5
+
 // ------- CheckResult -------
 
 bool CheckResult::isUnknown() const {
@@ -1481,13 +1939,17 @@ Expr Model::eval(const Expr &e, bool modelCompletion) const {
   SET_Z3(newe, fmap(z3, [modelCompletion, &e](auto &z3model){
     return z3model.eval(e.getZ3Expr(), modelCompletion);
   }));
-  SET_CVC5(newe, fupdate2(sctx.cvc5, e.cvc5, [](auto &solver, auto ec){
-    // getValue() creates a new BV, so the model gets invalidated
+#ifdef SOLVER_CVC5
+  if (cvc5 && e.cvc5) {
+    // Copying the term creates new terms in the query's solver, so the model
+    // gets invalidated.
     // re-running checkSat() is very expensive, but this is so far
     // the only way to retrieve the values
-    solver.checkSat();
-    return solver.getValue(ec);
-  }));
+    auto ec = cvc5->importTerm(*e.cvc5);
+    cvc5->solver.checkSat();
+    newe.setCVC5(cvc5->exportTerm(cvc5->solver.getValue(ec)));
+  }
+#endif // SOLVER_CVC5
 
   return newe;
 }
@@ -1497,12 +1959,18 @@ vector<Expr> Model::eval(const vector<Expr> &exprs, bool modelCompletion) const
   values.reserve(exprs.size());
 
 #ifdef SOLVER_CVC5
-  auto cvc5_values = fupdate(sctx.cvc5, [exprs](auto &solver) {
+  optional<vector<cvc5::api::Term>> cvc5_values;
+  if (cvc5) {
+    vector<cvc5::api::Term> cvc5_exprs;
+    for (auto &t: toCVC5TermVector(exprs))
+      cvc5_exprs.push_back(cvc5->importTerm(t));
     // see the comment at Expr Model::eval(const Expr &e, bool modelCompletion)
-    solver.checkSat();
-    auto cvc5_exprs = toCVC5TermVector(exprs);
-    return solver.getValue(cvc5_exprs);
-  });
+    cvc5->solver.checkSat();
+
+    cvc5_values.emplace();
+    for (auto &v: cvc5->solver.getValue(cvc5_exprs))
+      cvc5_values->push_back(cvc5->exportTerm(v));
+  }
 #endif // SOLVER_CVC5
 
   for (size_t i = 0; i < exprs.size(); ++i) {
@@ -1533,67 +2001,253 @@ Model Model::empty() {
   // FIXME
   Model m;
   SET_Z3(m, {*sctx.z3});
+  IF_CVC5_ENABLED(if (sctx.cvc5) m.cvc5 = make_shared<CVC5Query>("HO_ALL"));
   return m;
 }
 
 // ------- Solver -------
 
-Solver::Solver(const char *logic) {
 #ifdef SOLVER_Z3
-  z3 = fupdate(sctx.z3, [logic](auto &ctx){
+static vector<string> splitTacticNames(const string &pipeline) {
+  vector<string> names;
+  size_t begin = 0;
+  while (begin <= pipeline.size()) {
+    size_t end = pipeline.find(',', begin);
+    if (end == string::npos)
+      end = pipeline.size();
+    if (end > begin)
+      names.push_back(pipeline.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return names;
+}
+
+// Built-in tactic pipelines for the logics that vcgen uses.
+static z3::tactic mkPresetTactic(z3::context &ctx, string_view logic) {
+  auto t = [&ctx](const char *name) { return z3::tactic(ctx, name); };
+  // Cheap rewrites that remove most of the equalities between fresh
+  // variables and unconstrained terms that the encoder introduces.
+  auto preprocess = t("simplify") & t("propagate-values") & t("solve-eqs") &
+      t("elim-uncnstr") & t("simplify");
+
+  if (logic == "QF_AUFBV" || logic == "QF_UFBV") {
+    // If ackermannization removes all uninterpreted functions and arrays,
+    // bit-blast the query and solve it with the SAT solver.
+    // Otherwise (e.g. ackermannize_bv fails), fall back to the smt tactic.
+    auto bvOnly = z3::probe(ctx, "is-qfbv");
+    return preprocess & ((t("ackermannize_bv") &
+        z3::cond(bvOnly, t("bit-blast") & t("sat"), t("smt"))) | t("smt"));
+  } else if (logic == "AUFBV") {
+    return preprocess & t("smt");
+  }
+  // ALL: The query may contain constant arrays or bags; only simplify it.
+  return t("simplify") & t("smt");
+}
+
+static z3::tactic mkTactic(z3::context &ctx, const string &pipeline,
+    string_view logic) {
+  if (pipeline == "preset")
+    return mkPresetTactic(ctx, logic);
+
+  auto names = splitTacticNames(pipeline);
+  assert(!names.empty());
+  z3::tactic tactic(ctx, names[0].c_str());
+  for (size_t i = 1; i < names.size(); ++i)
+    tactic = tactic & z3::tactic(ctx, names[i].c_str());
+  return tactic;
+}
+
+static z3::solver mkZ3Solver(z3::context &ctx, const char *logic) {
+  if (sctx.tactic.empty())
     return z3::solver(ctx, logic);
+
+  auto s = mkTactic(ctx, sctx.tactic, logic).mk_solver();
+  // Solvers created from tactics do not inherit the context's timeout.
+  s.set("timeout", (unsigned)sctx.timeout_ms);
+  return s;
+}
+#endif // SOLVER_Z3
+
+Solver::Solver(const char *logic): logic(logic) {
+#ifdef SOLVER_Z3
+  z3 = fupdate(sctx.z3, [logic](auto &ctx){
+    return mkZ3Solver(ctx, logic);
   });
 #endif // SOLVER_Z3
 #ifdef SOLVER_CVC5
-  // We can't create new solver since it won't be compatible with
-  // the variables created by previous solver
   if (sctx.cvc5)
-    sctx.cvc5->push();
+    cvc5 = make_shared<CVC5Query>(logic);
 #endif // SOLVER_CVC5
 }
 
 Solver::~Solver() {
 #ifdef SOLVER_CVC5
-  // We can't destroy solver since it will invalidate every variable
-  // it has created
-  if (sctx.cvc5) {
+  if (sctx.cvc5)
     sctx.clearCachedTerms();
-    sctx.cvc5->pop();
-  }
 #endif // SOLVER_CVC5
 }
 
 void Solver::add(const Expr &e) {
+  assertions.push_back(e);
   IF_Z3_ENABLED(fupdate(z3, [&e](auto &solver) {
     solver.add(*e.z3);
     return 0;
   }));
-  IF_CVC5_ENABLED(fupdate(sctx.cvc5, [&e](auto &solver) {
-    solver.assertFormula(*e.cvc5);
-    return 0;
-  }));
+  IF_CVC5_ENABLED(if (cvc5) cvc5->add(*e.cvc5));
 }
 
 void Solver::reset() {
+  assertions.clear();
+  splitModel.reset();
   IF_Z3_ENABLED(fupdate(z3, [](auto &solver) { solver.reset(); return 0; }));
-  IF_CVC5_ENABLED(fupdate(sctx.cvc5, [](auto &solver) {
-    solver.resetAssertions();
-    return 0;
-  }));
+  IF_CVC5_ENABLED(if (cvc5) cvc5 = make_shared<CVC5Query>(logic));
+}
+
+void Solver::reset(const char *newLogic) {
+  logic = newLogic;
+  assertions.clear();
+  splitModel.reset();
+#ifdef SOLVER_Z3
+  z3 = fupdate(sctx.z3, [newLogic](auto &ctx){
+    return mkZ3Solver(ctx, newLogic);
+  });
+#endif // SOLVER_Z3
+  IF_CVC5_ENABLED(if (cvc5) cvc5 = make_shared<CVC5Query>(logic));
 }
 
 CheckResult Solver::check() {
   // TODO: concurrent run with solvers and return the fastest one?
   CheckResult cr;
   SET_Z3(cr, fupdate(z3, [](auto &solver) { return solver.check(); }));
-  SET_CVC5(cr, fupdate(sctx.cvc5,
-      [](auto &solver) { return solver.checkSat(); }));
+  IF_CVC5_ENABLED(if (cvc5) cr.setCVC5(cvc5->check()));
   return cr;
 }
 
+#ifdef SOLVER_Z3
+// Check the cubes in parallel. Each cube is solved in its own context since
+// a Z3 context cannot be used by multiple threads.
+static z3::check_result checkZ3CubesInParallel(
+    const vector<Expr> &assertions, const vector<Expr> &cubes,
+    const char *logic, unsigned numThreads, optional<size_t> &satCube,
+    optional<z3::model> &satModel) {
+  mutex mtx; // Guards sctx.z3 and the variables below
+  size_t nextCube = 0;
+  bool hasUnknown = false;
+  vector<z3::context *> running;
+  // The context of the SAT cube; satModelInCtx must be destroyed before it.
+  unique_ptr<z3::context> satCtx;
+  optional<z3::model> satModelInCtx;
+
+  auto worker = [&]() {
+    while (true) {
+      auto ctx = make_unique<z3::context>();
+      ctx->set("timeout", (int)sctx.timeout_ms);
+      optional<z3::solver> s;
+      size_t i;
+      {
+        lock_guard<mutex> lock(mtx);
+        if (satCube || nextCube >= cubes.size())
+          return;
+        i = nextCube++;
+
+        // Translating the terms reads sctx.z3, so this must be serialized.
+        z3::expr_vector query(*sctx.z3);
+        for (auto &e: assertions)
+          query.push_back(e.getZ3Expr());
+        query.push_back(cubes[i].getZ3Expr());
+
+        s.emplace(mkZ3Solver(*ctx, logic));
+        s->add(z3::expr_vector(*ctx, query));
+        running.push_back(ctx.get());
+      }
+
+      auto res = s->check();
+
+      lock_guard<mutex> lock(mtx);
+      running.erase(find(running.begin(), running.end(), ctx.get()));
+      if (satCube)
+        return;
+
+      if (res == z3::sat) {
+        satCube = i;
+        for (auto *c: running)
+          c->interrupt();
+        satModelInCtx = s->get_model();
+        s.reset();
+        satCtx = move(ctx);
+        return;
+      }
+      hasUnknown |= res == z3::unknown;
+    }
+  };
+
+  vector<thread> threads;
+  for (unsigned t = 0; t < min((size_t)numThreads, cubes.size()); ++t)
+    threads.emplace_back(worker);
+  for (auto &t: threads)
+    t.join();
+
+  if (satCube) {
+    satModel.emplace(*satModelInCtx, *sctx.z3, z3::model::translate());
+    satModelInCtx.reset();
+    return z3::sat;
+  }
+  return hasUnknown ? z3::unknown : z3::unsat;
+}
+#endif // SOLVER_Z3
+
+CheckResult Solver::checkSplit(const vector<Expr> &cubes,
+    unsigned numThreads, optional<size_t> &satCube) {
+  satCube.reset();
+  splitModel.reset();
+  if (cubes.empty())
+    return check();
+
+#ifdef SOLVER_Z3
+  bool useCVC5 = false;
+  IF_CVC5_ENABLED(useCVC5 = (bool)cvc5);
+  if (z3 && !useCVC5 && numThreads > 1) {
+    optional<z3::model> satModel;
+    CheckResult cr;
+    cr.setZ3(checkZ3CubesInParallel(assertions, cubes, logic.c_str(),
+        numThreads, satCube, satModel));
+    if (satModel) {
+      Model m;
+      m.setZ3(move(satModel));
+      splitModel.emplace(move(m));
+    }
+    return cr;
+  }
+#endif // SOLVER_Z3
+
+  optional<CheckResult> unknownResult;
+  optional<CheckResult> lastResult;
+  for (size_t i = 0; i < cubes.size(); ++i) {
+    Solver s(logic.c_str());
+    for (auto &e: assertions)
+      s.add(e);
+    s.add(cubes[i]);
+
+    auto res = s.check();
+    if (res.hasSat()) {
+      satCube = i;
+      splitModel.emplace(s.getModel());
+      return res;
+    } else if (!res.hasUnsat() && !unknownResult) {
+      unknownResult = res;
+    }
+    lastResult = res;
+  }
+  return unknownResult ? *unknownResult : *lastResult;
+}
+
 Model Solver::getModel() const {
+  if (splitModel)
+    return *splitModel;
+
   Model m;
   SET_Z3(m, fmap(z3, [](auto &solver) { return solver.get_model(); }));
+  IF_CVC5_ENABLED(m.cvc5 = cvc5);
   return m;
 }
 
@@ -1604,6 +2258,35 @@ void useCVC5() { IF_CVC5_ENABLED(sctx.useCVC5()); }
 uint64_t getTimeout() { return sctx.timeout_ms; }
 void setTimeout(const uint64_t ms) { sctx.timeout_ms = ms; }
 
+bool setTactic(const string &tactic) {
+  if (tactic.empty() || tactic == "default") {
+    sctx.tactic.clear();
+    return true;
+  }
+
+#ifdef SOLVER_Z3
+  if (tactic != "preset") {
+    auto names = splitTacticNames(tactic);
+    if (names.empty())
+      return false;
+    // Reject unknown tactics early rather than at the first query.
+    if (sctx.z3) {
+      for (auto &name: names) {
+        try {
+          z3::tactic(*sctx.z3, name.c_str());
+        } catch (z3::exception &) {
+          return false;
+        }
+      }
+    }
+  }
+#endif // SOLVER_Z3
+  sctx.tactic = tactic;
+  return true;
+}
+
+const string &getTactic() { return sctx.tactic; }
+
 
 
 namespace matchers {
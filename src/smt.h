@@ -1,8 +1,10 @@
 #pragma once
 
 #include "llvm/Support/raw_ostream.h"
+#include <memory>
 #include <vector>
 #include <optional>
+#include <string>
 
 #ifdef SOLVER_Z3
   #include "z3++.h"
@@ -56,6 +58,9 @@ std::string or_omit(const std::vector<Expr> &evec);
 
 
 class Solver;
+#ifdef SOLVER_CVC5
+class CVC5Query;
+#endif
 
 template<class T_Z3, class T_CVC5>
 class Object {
@@ -97,6 +102,18 @@ public:
   void unlockOps();
 
   Expr simplify() const;
+  // Rewrite select(lambda i. body, j) into body[i:=j], push select into ite,
+  // and collapse (lambda i. a[i]) into a if a is a constant.
+  // Only the Z3 expression is rewritten.
+  Expr betaReduce() const;
+  // Rewrite (forall v1 .. vn, (v1 < c1 & .. & vn < cn & ..) => body) into the
+  // conjunction of its instances if c1 * .. * cn <= maxInstances.
+  // numExpanded is increased by the number of rewritten quantifiers.
+  // Only the Z3 expression is rewritten.
+  Expr expandForalls(uint64_t maxInstances, unsigned &numExpanded) const;
+  // The number of distinct nodes in the DAG of the expression, including the
+  // bodies of quantifiers.
+  size_t getDAGSize() const;
   Sort sort() const;
   unsigned bitwidth() const;
   std::vector<Expr> toNDIndices(const std::vector<Expr> &dims) const;
@@ -116,6 +133,9 @@ public:
   bool isVar() const;
   // Returns true if expression is quantifier.
   bool hasQuantifier() const;
+  // Returns true if the expression has neither array-sorted subterms nor
+  // quantifiers/lambdas. Always returns false with CVC5 only.
+  bool isArrayAndQuantifierFree() const;
   std::string getVarName() const;
 
   Expr urem(const Expr &rhs) const;
@@ -283,8 +303,7 @@ public:
   friend Solver;
 };
 
-// TODO: Model and Solver are special because they simply reuse
-// cvc5::api::Solver.
+// TODO: Model and Solver are special because they do not derive Object.
 class Model {
 private:
   Model() {}
@@ -293,7 +312,10 @@ private:
   std::optional<z3::model> z3;
   void setZ3(std::optional<z3::model> &&m) { z3 = std::move(m); }
 #endif
-  // No need for CVC5
+#ifdef SOLVER_CVC5
+  // The query that found this model
+  std::shared_ptr<CVC5Query> cvc5;
+#endif
 
 public:
   Expr eval(const Expr &e, bool modelCompletion = false) const;
@@ -305,11 +327,21 @@ public:
 };
 
 class Solver {
+private:
+  std::string logic;
+  std::vector<Expr> assertions;
+  // The model of the cube found by checkSplit
+  std::optional<Model> splitModel;
+
 public:
 #ifdef SOLVER_Z3
   std::optional<z3::solver> z3;
 #endif
-  // No need for CVC5
+#ifdef SOLVER_CVC5
+  // A fresh cvc5 solver whose logic is decided from the query.
+  // The terms are created by the global context, and copied to this solver.
+  std::shared_ptr<CVC5Query> cvc5;
+#endif
 
   Solver(const char *logic);
   Solver(const Solver &) = delete;
@@ -317,14 +349,32 @@ public:
 
   void add(const Expr &e);
   void reset();
+  // Reset the solver and use newLogic from now on.
+  void reset(const char *newLogic);
   CheckResult check();
+  // Check the assertions conjoined with each cube, using up to numThreads
+  // threads (with CVC5, the cubes are checked one by one).
+  // Stops at the first SAT cube; the result is SAT if there is such a cube,
+  // UNSAT if every cube is UNSAT, and unknown otherwise.
+  // satCube is the index of the SAT cube, and getModel() returns its model.
+  // The disjunction of the cubes must be valid under the assertions.
+  CheckResult checkSplit(const std::vector<Expr> &cubes, unsigned numThreads,
+                         std::optional<size_t> &satCube);
   Model getModel() const;
+  const char *getLogic() const { return logic.c_str(); }
 };
 
 void useZ3();
 void useCVC5();
 uint64_t getTimeout();
 void setTimeout(const uint64_t ms);
+// Select the Z3 tactic pipeline that Solver uses.
+//   "": Z3's default solver for the given logic
+//   "preset": the built-in pipeline for the given logic
+//   "t1,t2,...": apply tactics t1, t2, ... in sequence
+// Returns false if the pipeline contains an unknown tactic.
+bool setTactic(const std::string &tactic);
+const std::string &getTactic();
 } // namespace smt
 
 llvm::raw_ostream& operator<<(llvm::raw_ostream& os, const smt::Expr &e);
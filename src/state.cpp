@@ -100,6 +100,28 @@ Expr State::isWellDefined() const {
   return e;
 }
 
+Expr State::isWellDefined(const llvm::DenseSet<mlir::Operation *> &ops) const {
+  // Conditions that are not attached to an op are always included.
+  auto isInOps = [&ops](mlir::Operation *op) {
+    if (!op)
+      return true;
+    for (; op; op = op->getParentOp()) {
+      if (ops.contains(op))
+        return true;
+    }
+    return false;
+  };
+
+  Expr e = Expr::mkBool(true);
+  for (auto &ubmap: welldef) {
+    if (!isInOps(ubmap.first))
+      continue;
+    for (auto &itm: ubmap.second)
+      e = e & itm.second;
+  }
+  return e;
+}
+
 Expr State::isOpWellDefined(mlir::Operation *op) const {
   auto ubmap = welldef.find(op);
   if (ubmap == welldef.end())
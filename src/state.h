@@ -4,6 +4,7 @@
 #include "smt.h"
 #include "value.h"
 #include "mlir/Dialect/Linalg/IR/Linalg.h"
+#include "llvm/ADT/DenseSet.h"
 #include <stack>
 #include <optional>
 #include "mlir/Support/LLVM.h"
@@ -79,6 +80,8 @@ public:
   void wellDefined(mlir::Operation *op, smt::Expr &&e, std::string &&desc = "");
   smt::Expr precondition() const;
   smt::Expr isWellDefined() const;
+  // Is every op in ops (including the ops nested in them) well-defined?
+  smt::Expr isWellDefined(const llvm::DenseSet<mlir::Operation *> &ops) const;
   smt::Expr isOpWellDefined(mlir::Operation *op) const;
   std::map<std::string, smt::Expr> getOpWellDefinedness(mlir::Operation *op)
       const;
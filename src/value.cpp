@@ -93,7 +93,89 @@ vector<Expr> ShapedValue::getDims(
   return dims;
 }
 
-Index::Index(unsigned i): e(Expr::mkBV(i, BITS)) {}
+// Wrap v around like a bit-vector of the given width.
+static uint64_t truncateTo(uint64_t v, unsigned bw) {
+  return bw >= 64 ? v : v & ((1ull << bw) - 1);
+}
+
+Index::Index(unsigned i): known(truncateTo(i, BITS)) {}
+
+Index::Index(const Expr &e): known(e.asUInt()), e(e) {
+  this->e->unlockOps();
+}
+
+Index::Index(Expr &&e): known(e.asUInt()), e(move(e)) {
+  this->e->unlockOps();
+}
+
+Index Index::fromKnown(uint64_t v) {
+  Index i(0u);
+  i.known = truncateTo(v, BITS);
+  return i;
+}
+
+Index::operator Expr() const {
+  if (!e) {
+    e = Expr::mkBV(*known, BITS);
+    e->unlockOps();
+  }
+  return *e;
+}
+
+Index Index::operator*(const Index &b) const {
+  if (known && b.known)
+    return fromKnown(*known * *b.known);
+  return Index((Expr)*this * (Expr)b);
+}
+
+Index Index::operator+(const Index &b) const {
+  if (known && b.known)
+    return fromKnown(*known + *b.known);
+  return Index((Expr)*this + (Expr)b);
+}
+
+Index Index::operator-(const Index &b) const {
+  if (known && b.known)
+    return fromKnown(*known - *b.known);
+  return Index((Expr)*this - (Expr)b);
+}
+
+Index Index::udiv(const Index &b) const {
+  // If the divisor is zero, follow the solver's behavior
+  if (known && b.known && *b.known != 0)
+    return fromKnown(*known / *b.known);
+  return Index(((Expr)*this).udiv(b));
+}
+
+Index Index::urem(const Index &b) const {
+  if (known && b.known && *b.known != 0)
+    return fromKnown(*known % *b.known);
+  return Index(((Expr)*this).urem(b));
+}
+
+Expr Index::operator==(const Index &b) const {
+  if (known && b.known)
+    return Expr::mkBool(*known == *b.known);
+  return (Expr)*this == (Expr)b;
+}
+
+Expr Index::ult(const Index &b) const {
+  if (known && b.known)
+    return Expr::mkBool(*known < *b.known);
+  return ((Expr)*this).ult(b);
+}
+
+Index Index::fromInteger(const Integer &i) {
+  if (auto v = i.asUInt())
+    return fromKnown(*v);
+  return Index((Expr)i);
+}
+
+Integer Index::asInteger() const {
+  if (known)
+    return Integer(*known, BITS);
+  return Integer(*e);
+}
 
 Sort Index::sort() {
   return Sort::bvSort(BITS);
@@ -133,7 +215,7 @@ pair<Expr, vector<Expr>> Index::refines(const Index &other) const {
 }
 
 Index Index::eval(Model m) const {
-  return Index(m.eval(e, true).simplify());
+  return Index(m.eval(*this, true).simplify());
 }
 
 optional<Sort> Float::sort(mlir::Type t) {
@@ -256,8 +338,55 @@ Float Float::truncate(const mlir::Type &tgt_type) const {
 
 
 
-Integer::Integer(int64_t i, unsigned bw):
-  e(Expr::mkBV(i, bw)) {}
+Integer::Integer(const Expr &e): e(e) {
+  this->e->unlockOps();
+  if (auto v = e.asUInt()) {
+    bw = e.bitwidth();
+    if (bw <= 64)
+      known = v;
+  }
+}
+
+Integer::Integer(int64_t i, unsigned bw): bw(bw) {
+  if (bw <= 64)
+    known = truncateTo(i, bw);
+  else {
+    e = Expr::mkBV(i, bw);
+    e->unlockOps();
+  }
+}
+
+Integer::operator Expr() const {
+  if (!e) {
+    e = Expr::mkBV(*known, bw);
+    e->unlockOps();
+  }
+  return *e;
+}
+
+Integer Integer::operator+(const Integer &b) const {
+  if (known && b.known)
+    return Integer(truncateTo(*known + *b.known, bw), bw);
+  return Integer((Expr)*this + (Expr)b);
+}
+
+Integer Integer::operator-(const Integer &b) const {
+  if (known && b.known)
+    return Integer(truncateTo(*known - *b.known, bw), bw);
+  return Integer((Expr)*this - (Expr)b);
+}
+
+Integer Integer::operator*(const Integer &b) const {
+  if (known && b.known)
+    return Integer(truncateTo(*known * *b.known, bw), bw);
+  return Integer((Expr)*this * (Expr)b);
+}
+
+Expr Integer::operator==(const Integer &b) const {
+  if (known && b.known)
+    return Expr::mkBool(*known == *b.known);
+  return (Expr)*this == (Expr)b;
+}
 
 Integer::Integer(const llvm::APInt &api):
   Integer(api.getSExtValue(), api.getBitWidth()) {}
@@ -290,7 +419,7 @@ pair<Expr, vector<Expr>> Integer::refines(const Integer &other) const {
 }
 
 Integer Integer::eval(Model m) const {
-  return Integer(m.eval(e, true).simplify());
+  return Integer(m.eval(*this, true).simplify());
 }
 
 pair<vector<smt::Expr>, smt::Expr> ShapedValue::conv(
@@ -412,6 +541,35 @@ static Sort arraySortForTensor(Sort elemSort) {
   return Sort::arraySort(Index::sort(), elemSort);
 }
 
+// Return the static 1D size if it is small enough to scalarize.
+static optional<uint64_t> getScalarizableSize(const vector<Expr> &dims) {
+  if (Tensor::MAX_SCALARIZE_SIZE == 0)
+    return nullopt;
+
+  uint64_t size = 1;
+  for (auto &d: dims) {
+    uint64_t n;
+    if (!d.isUInt(n))
+      return nullopt;
+    size *= n;
+    if (size > Tensor::MAX_SCALARIZE_SIZE)
+      return nullopt;
+  }
+  if (size == 0)
+    return nullopt;
+  return size;
+}
+
+// lambda idx, (idx == 0 ? elems[0] : idx == 1 ? elems[1] : ...)
+static Expr scalarizedArray(const vector<Expr> &elems) {
+  assert(!elems.empty());
+  Expr idx = Index::var("idx", VarType::BOUND);
+  Expr body = elems.back();
+  for (size_t i = elems.size() - 1; i > 0; --i)
+    body = Expr::mkIte(idx == Index((unsigned)i - 1), elems[i - 1], body);
+  return Expr::mkLambda(idx, body);
+}
+
 static Expr splatArrayForTensor(const Expr &elem) {
   return Expr::mkSplatArray(Index::sort(), elem);
 }
@@ -422,15 +580,24 @@ Tensor::Tensor(mlir::Type elemType, Expr &&splat_elem, vector<Expr> &&dimvec):
     arr(splatArrayForTensor(move(splat_elem))),
     initialized(splatArrayForTensor(Expr::mkBool(true))) {}
 
+static Expr denseArrayForTensor(const vector<Expr> &dims,
+    const vector<Expr> &elems1d) {
+  if (getScalarizableSize(dims))
+    return scalarizedArray(elems1d);
+
+  Expr arr = Expr::mkFreshVar(arraySortForTensor(elems1d[0].sort()),
+      "tensor_val");
+  for (unsigned i = 0; i < elems1d.size(); ++i)
+    arr = arr.store(i, elems1d[i]);
+  return arr;
+}
+
 // A dense tensor (1dim)
 Tensor::Tensor(mlir::Type elemType, vector<Expr> &&elems1d):
     ShapedValue(elemType),
     dims({ (Expr)Index(elems1d.size()) }),
-    arr(Expr::mkFreshVar(arraySortForTensor(elems1d[0].sort()), "tensor_val")),
-    initialized(splatArrayForTensor(Expr::mkBool(true))) {
-  for (unsigned i = 0; i < elems1d.size(); ++i)
-    arr = arr.store(i, elems1d[i]);
-}
+    arr(denseArrayForTensor(dims, elems1d)),
+    initialized(splatArrayForTensor(Expr::mkBool(true))) {}
 
 // A fresh tensor
 Tensor Tensor::var(
@@ -445,9 +612,18 @@ Tensor Tensor::var(
 Tensor Tensor::var(
     mlir::Type elemType, string &&name, const vector<Expr> &dimvec,
     bool initialized) {
-  Expr arr = Expr::mkVar(
-      arraySortForTensor(*convertPrimitiveTypeToSort(elemType)), move(name));
+  auto elemSort = *convertPrimitiveTypeToSort(elemType);
   Expr init = splatArrayForTensor(Expr::mkBool(initialized));
+
+  if (auto size = getScalarizableSize(dimvec)) {
+    vector<Expr> elems;
+    for (uint64_t i = 0; i < *size; ++i)
+      elems.push_back(Expr::mkVar(elemSort, name + "#" + to_string(i)));
+    return Tensor(elemType, vector(dimvec), scalarizedArray(elems),
+        move(init));
+  }
+
+  Expr arr = Expr::mkVar(arraySortForTensor(elemSort), move(name));
   return Tensor(elemType, vector(dimvec), move(arr), move(init));
 }
 
@@ -500,6 +676,16 @@ Expr Tensor::isInBounds(const vector<smt::Expr> &indices) const {
 }
 
 Expr Tensor::get(const vector<Expr> &indices) const {
+  if (view && view->indVars.size() == indices.size()) {
+    vector<Expr> baseIdxs;
+    for (auto &i: view->baseIdxs)
+      baseIdxs.push_back(view->indVars.empty() ? i :
+          i.substitute(view->indVars, indices).simplify());
+
+    auto e = view->baseArr.select(to1DIdx(baseIdxs, view->baseDims));
+    e.lockOps();
+    return e;
+  }
   return getRaw(to1DIdx(indices, dims));
 }
 
@@ -540,6 +726,10 @@ Tensor Tensor::affine(
     const vector<Expr> &newidxvars,
     vector<Expr> srcidxs,
     vector<Expr> &&newsizes) const {
+  if (all_of(newidxvars.begin(), newidxvars.end(),
+      [](const Expr &e) { return e.isVar(); }))
+    return remap(move(newsizes), vector(newidxvars), srcidxs);
+
   auto idxvar = Index::var("idx", VarType::BOUND);
   auto indices = from1DIdx(idxvar, newsizes);
 
@@ -560,6 +750,32 @@ Tensor Tensor::affine(
   };
 }
 
+Tensor Tensor::remap(
+    vector<Expr> &&newdims,
+    vector<Expr> &&indVars,
+    const vector<Expr> &srcIdxs) const {
+  View v;
+  if (view) {
+    // Compose the index maps so that the new view refers to the base array.
+    v.baseArr = view->baseArr;
+    v.baseDims = view->baseDims;
+    for (auto &i: view->baseIdxs)
+      v.baseIdxs.push_back(view->indVars.empty() ? i :
+          i.substitute(view->indVars, srcIdxs).simplify());
+  } else {
+    v.baseArr = arr;
+    v.baseDims = dims;
+    v.baseIdxs = simplifyList(srcIdxs);
+  }
+  v.indVars = indVars;
+
+  auto body = get(srcIdxs);
+  auto t = mkInitializedLambda(elemType, move(newdims), move(indVars),
+      move(body));
+  t.view = move(v);
+  return t;
+}
+
 Tensor Tensor::concat(const Tensor &t2, size_t axis) {
   size_t r = getRank();
   assert(r == t2.getRank() && getElemType() == t2.getElemType() && axis < r);
@@ -956,21 +1172,104 @@ pair<Expr, vector<Expr>> Tensor::refines(const Tensor &other) const {
   if (size_match.isFalse())
     return {size_match, {}};
 
+  auto refinesAt = [&](const Expr &i) {
+    ValueTy arr_i = *fromExpr(arr.select(i), elemType);
+    ValueTy arr_other_i = *fromExpr(other.arr.select(i), elemType);
+    auto refinement = ::refines(arr_i, arr_other_i);
+    assert(refinement.second.empty());
+    return initialized.select(i).implies(
+        other.initialized.select(i) & refinement.first);
+  };
+
+  if (auto size = getScalarizedSize(); size && size_match.isTrue()) {
+    // Check the elements one by one without an unbound index variable.
+    Expr refinement = Expr::mkBool(true);
+    for (uint64_t i = 0; i < *size; ++i)
+      refinement = refinement & refinesAt(Index((unsigned)i));
+    return {refinement, {}};
+  }
+
   // Assume that src and tgt's shape equality is already checked
   Expr i = Index::var("i", VarType::UNBOUND);
   vector<Expr> params = {i};
-  ValueTy arr_i = *fromExpr(arr.select(i), elemType);
-  ValueTy arr_other_i = *fromExpr(other.arr.select(i), elemType);
-  auto refinement = ::refines(arr_i, arr_other_i);
-  assert(refinement.second.empty());
-
-  return {size_match &
-      i.ult(::get1DSize(dims)).implies(
-        initialized.select(i).implies(
-            other.initialized.select(i) & refinement.first)),
+
+  return {size_match & i.ult(::get1DSize(dims)).implies(refinesAt(i)),
     params};
 }
 
+optional<uint64_t> Tensor::getScalarizedSize() const {
+  return getScalarizableSize(dims);
+}
+
+vector<Expr> Tensor::splitRefinement(const vector<Expr> &params,
+    unsigned maxBoxes) const {
+  assert(params.size() == 1);
+  auto &i = params[0];
+
+  vector<uint64_t> sizes;
+  for (auto &d: dims) {
+    uint64_t sz;
+    if (!d.isUInt(sz))
+      return {};
+    sizes.push_back(sz);
+  }
+
+  // A box is [lo, hi) for each dimension, and the number of boundary faces
+  // that it touches.
+  struct Box {
+    vector<pair<uint64_t, uint64_t>> ranges;
+    unsigned boundaries;
+  };
+  vector<Box> boxes(1);
+  for (auto sz: sizes)
+    boxes[0].ranges.emplace_back(0, sz);
+  boxes[0].boundaries = 0;
+
+  // Peel the first and last rows off the larger dimensions first.
+  vector<unsigned> dimOrder(sizes.size());
+  for (unsigned d = 0; d < dimOrder.size(); ++d)
+    dimOrder[d] = d;
+  stable_sort(dimOrder.begin(), dimOrder.end(),
+      [&sizes](unsigned a, unsigned b) { return sizes[a] > sizes[b]; });
+
+  for (auto d: dimOrder) {
+    if (sizes[d] < 3 || boxes.size() * 3 > maxBoxes)
+      continue;
+
+    vector<Box> newBoxes;
+    for (auto &box: boxes) {
+      auto low = box, mid = box, high = box;
+      low.ranges[d] = {0, 1};
+      mid.ranges[d] = {1, sizes[d] - 1};
+      high.ranges[d] = {sizes[d] - 1, sizes[d]};
+      low.boundaries++;
+      high.boundaries++;
+      newBoxes.push_back(move(low));
+      newBoxes.push_back(move(high));
+      newBoxes.push_back(move(mid));
+    }
+    boxes = move(newBoxes);
+  }
+
+  stable_sort(boxes.begin(), boxes.end(), [](const Box &a, const Box &b) {
+    return a.boundaries > b.boundaries;
+  });
+
+  auto idxs = from1DIdx(i, dims);
+  vector<Expr> cubes;
+  for (auto &box: boxes) {
+    Expr cube = i.ult(::get1DSize(dims));
+    for (unsigned d = 0; d < sizes.size(); ++d) {
+      auto [lo, hi] = box.ranges[d];
+      if (lo == 0 && hi == sizes[d])
+        continue;
+      cube = cube & idxs[d].uge(lo) & idxs[d].ult(hi);
+    }
+    cubes.push_back(cube.simplify());
+  }
+  return cubes;
+}
+
 bool Tensor::isTypeSupported(mlir::TensorType tensorTy) {
   if (!tensorTy.hasRank())
     return false;
@@ -1087,8 +1386,7 @@ Tensor Tensor::reverse(unsigned axis) const {
   accessIdx[axis] = dims[axis] - accessIdx[axis] - 1;
 
   // UB if uninitialized
-  return Tensor::mkInitializedLambda(elemType, vector(dims), move(indVars),
-      get(accessIdx));
+  return remap(vector(dims), move(indVars), accessIdx);
 }
 
 Tensor Tensor::tile(const vector<unsigned> &repeat) const {
@@ -1113,8 +1411,7 @@ Tensor Tensor::transpose() const {
   auto j = Index::var("j", VarType::BOUND);
 
   // UB if uninitialized
-  return Tensor::mkInitializedLambda(
-      elemType, {dims[1], dims[0]}, {j, i}, get({i, j}));
+  return remap({dims[1], dims[0]}, {j, i}, {i, j});
 }
 
 Tensor Tensor::mkLambda(
@@ -1283,6 +1580,99 @@ static bool isSimpleReduction(mlir::ElementsAttr attr1, mlir::ElementsAttr attr2
   return true;
 }
 
+namespace {
+// The elements of a non-splat dense constant as runs of equal elements.
+// If the elements repeat with a period that is the size of the innermost
+// dimensions (e.g. all rows are equal), only the first period is kept and
+// the element at idx is the one at idx % period.
+struct CompressedElems {
+  uint64_t numElements;
+  uint64_t period;
+  // Run i covers [runStarts[i], runStarts[i + 1]) (or up to period for the
+  // last run).
+  vector<uint64_t> runStarts;
+};
+}
+
+// Compress the elements at elems (a random access iterator) in row-major
+// order. Return nullopt as soon as there are more than maxRuns runs.
+template<class Iterator, class Eq>
+static optional<CompressedElems> compressElems(Iterator elems,
+    llvm::ArrayRef<int64_t> shape, uint64_t total, uint64_t maxRuns, Eq eq) {
+  CompressedElems c{total, total, {}};
+  uint64_t p = 1;
+  for (int64_t i = (int64_t)shape.size() - 1; i > 0; --i) {
+    p *= shape[i];
+    bool repeats = true;
+    for (uint64_t j = p; j < total && repeats; ++j)
+      repeats = eq(elems[j], elems[j - p]);
+    if (repeats) {
+      c.period = p;
+      break;
+    }
+  }
+
+  for (uint64_t j = 0; j < c.period; ++j) {
+    if (j == 0 || !eq(elems[j], elems[j - 1])) {
+      if (c.runStarts.size() == maxRuns)
+        return nullopt;
+      c.runStarts.push_back(j);
+    }
+  }
+  return c;
+}
+
+// Compress the elements of attr by their raw values. Return nullopt if there
+// are more than MAX_CONST_SIZE runs.
+// The analysis and the encoding of each function see the same constants, so
+// the result is cached.
+static optional<CompressedElems> compressElems(mlir::DenseElementsAttr attr) {
+  static llvm::DenseMap<mlir::Attribute,
+      pair<uint64_t, optional<CompressedElems>>> cache;
+
+  uint64_t maxRuns = Tensor::MAX_CONST_SIZE;
+  auto itr = cache.find(attr);
+  if (itr != cache.end() && itr->second.first == maxRuns)
+    return itr->second.second;
+
+  auto shape = attr.getType().getShape();
+  uint64_t total = attr.getNumElements();
+  auto elemTy = attr.getElementType();
+  optional<CompressedElems> c;
+  if (elemTy.isa<mlir::FloatType>())
+    c = compressElems(attr.getValues<llvm::APFloat>().begin(), shape, total,
+        maxRuns, [](const llvm::APFloat &a, const llvm::APFloat &b) {
+          return a.bitwiseIsEqual(b); });
+  else if (elemTy.isIntOrIndex())
+    c = compressElems(attr.getValues<llvm::APInt>().begin(), shape, total,
+        maxRuns, [](const llvm::APInt &a, const llvm::APInt &b) {
+          return a == b; });
+  else
+    c = compressElems(attr.getValues<mlir::Attribute>().begin(), shape, total,
+        maxRuns, [](mlir::Attribute a, mlir::Attribute b) { return a == b; });
+
+  cache[attr] = {maxRuns, c};
+  return c;
+}
+
+// Binary search for the run of idx among the runs [lo, hi).
+static Expr selectRun(const Expr &idx, const CompressedElems &c,
+    const vector<Expr> &runExprs, size_t lo, size_t hi) {
+  if (hi - lo == 1)
+    return runExprs[lo];
+  size_t mid = (lo + hi) / 2;
+  return Expr::mkIte(idx.ult(c.runStarts[mid]),
+      selectRun(idx, c, runExprs, lo, mid),
+      selectRun(idx, c, runExprs, mid, hi));
+}
+
+optional<uint64_t> Tensor::getConstEncodingSize(
+    mlir::DenseElementsAttr attr) {
+  if (auto c = compressElems(attr))
+    return c->runStarts.size();
+  return nullopt;
+}
+
 Tensor Tensor::fromElemsAttr(mlir::RankedTensorType tensorty,
       mlir::ElementsAttr attr) {
   mlir::Type elemType = tensorty.getElementType();
@@ -1297,20 +1687,17 @@ Tensor Tensor::fromElemsAttr(mlir::RankedTensorType tensorty,
 
     } else {
       int64_t rank = tensorty.getRank();
-      vector<int64_t> dims;
       vector<Expr> dimExprs;
-      int64_t totalSize = 1;
       for (int i = 0; i < rank; ++i) {
         auto dsize = tensorty.getDimSize(i);
         assert(dsize != mlir::ShapedType::kDynamicSize);
-        dims.push_back(dsize);
         dimExprs.push_back(Index(dsize));
-        totalSize *= dsize;
       }
 
-      if (MAX_CONST_SIZE >= 0 && totalSize > MAX_CONST_SIZE) {
+      auto compressedOrNone = compressElems(denseAttr);
+      if (!compressedOrNone) {
         verbose("Tensor::fromElemsAttr") << "Too many elements: " <<
-            totalSize << " > " << MAX_CONST_SIZE << "\n";
+            denseAttr.getNumElements() << " > " << MAX_CONST_SIZE << "\n";
 
         for (auto &[a, t]: abstractlyEncodedAttrs) {
           if (a == attr) {
@@ -1359,27 +1746,43 @@ Tensor Tensor::fromElemsAttr(mlir::RankedTensorType tensorty,
         return newt;
       }
 
-      // [i1, i2, ..., iN]
-      vector<uint64_t> idxND(rank);
-      vector<Expr> exprs;
-
-      while (true) {
-        if (idxND.back() == dims.back()) {
-          int focus = rank - 1;
-          while (1 <= focus && idxND[focus] == dims[focus]) {
-            idxND[focus] = 0;
-            idxND[focus - 1]++;
-            focus--;
-          }
+      auto &compressed = *compressedOrNone;
+      uint64_t encodingSize = compressed.runStarts.size();
+
+      // Encode each distinct value once.
+      auto attrs = denseAttr.getValues<mlir::Attribute>().begin();
+      llvm::DenseMap<mlir::Attribute, size_t> valueIds;
+      vector<Expr> values, runExprs;
+      for (auto start: compressed.runStarts) {
+        mlir::Attribute a = attrs[start];
+        auto [itr, inserted] = valueIds.try_emplace(a, values.size());
+        if (inserted)
+          values.push_back(getExpr(attrToValueTy(a)));
+        runExprs.push_back(values[itr->second]);
+      }
 
-          if (idxND[0] == dims[0])
-            break;
-        }
+      if (encodingSize < compressed.numElements &&
+          !getScalarizableSize(dimExprs)) {
+        verbose("Tensor::fromElemsAttr") << "Encoding "
+            << compressed.numElements << " elements as " << encodingSize
+            << " runs with period " << compressed.period << "\n";
+        Expr idx = Index::var("idx", VarType::BOUND);
+        Expr ofs = compressed.period == compressed.numElements ?
+            idx : idx.urem(compressed.period);
+        auto body = selectRun(ofs, compressed, runExprs, 0, encodingSize);
+        return mkLambdaFrom1D(elemType, move(dimExprs), move(idx), body,
+            Expr::mkBool(true));
+      }
 
-        exprs.push_back(getExpr(
-            attrToValueTy(denseAttr.getValues<mlir::Attribute>()[idxND])));
-        idxND.back()++;
+      vector<Expr> exprs;
+      for (size_t i = 0; i < encodingSize; ++i) {
+        uint64_t end = i + 1 < encodingSize ?
+            compressed.runStarts[i + 1] : compressed.period;
+        for (uint64_t j = compressed.runStarts[i]; j < end; ++j)
+          exprs.push_back(runExprs[i]);
       }
+      for (uint64_t j = compressed.period; j < compressed.numElements; ++j)
+        exprs.push_back(exprs[j - compressed.period]);
 
       return Tensor(elemType, move(exprs)).reshape(dimExprs);
     }
@@ -1459,12 +1862,67 @@ Expr Tensor::to1DArrayWithOfs(
   return Expr::mkLambda(idxvar, elem);
 }
 
+// d_i < dims[i] for each i
+static vector<MemRef::Layout::Bound> boundsOfDims(const vector<Expr> &dims) {
+  vector<MemRef::Layout::Bound> bounds;
+  for (size_t i = 0; i < dims.size(); ++i) {
+    vector<Expr> coeffs(dims.size(), Index::zero());
+    coeffs[i] = Index::one();
+    bounds.push_back({Index::zero(), move(coeffs), dims[i]});
+  }
+  return bounds;
+}
+
+static Expr evalBound(const MemRef::Layout::Bound &b,
+    const vector<Expr> &indices) {
+  Index e = b.offset;
+  for (size_t i = 0; i < b.coeffs.size(); ++i)
+    e = e + Index(b.coeffs[i]) * indices[i];
+  return e.ult(b.size);
+}
+
+static bool isIdenticalBound(const MemRef::Layout::Bound &a,
+    const MemRef::Layout::Bound &b) {
+  if (!a.offset.isIdentical(b.offset, false) ||
+      !a.size.isIdentical(b.size, false) ||
+      a.coeffs.size() != b.coeffs.size())
+    return false;
+  for (size_t i = 0; i < a.coeffs.size(); ++i)
+    if (!a.coeffs[i].isIdentical(b.coeffs[i], false))
+      return false;
+  return true;
+}
+
+// Add b to bounds unless it trivially holds or is already there.
+static void addBound(vector<MemRef::Layout::Bound> &bounds,
+    MemRef::Layout::Bound &&b) {
+  b.offset = b.offset.simplify();
+  b.size = b.size.simplify();
+  b.coeffs = simplifyList(b.coeffs);
+
+  bool hasVar = any_of(b.coeffs.begin(), b.coeffs.end(),
+      [](const Expr &c) { return Index(c).asUInt() != 0; });
+  if (!hasVar && Index(b.offset).ult(b.size).simplify().isTrue())
+    return;
+  for (auto &b2: bounds)
+    if (isIdenticalBound(b, b2))
+      return;
+  bounds.push_back(move(b));
+}
+
 MemRef::Layout::Layout(const vector<Expr> &dims):
-    precondition(Expr::mkBool(true)) {
+    precondition(Expr::mkBool(true)), isIdentity(true) {
   this->indVars = Index::boundIndexVars(dims.size());
   this->inbounds = [dims](auto &indices) { return fitsInDims(indices, dims); };
   this->mapping = [dims](auto &indices) { return to1DIdx(indices, dims); };
   this->inverseMappings = [dims](auto &index) { return from1DIdx(index, dims);};
+
+  // The row-major strides
+  vector<Expr> strides(dims.size(), Index::one());
+  for (size_t i = dims.size(); i > 1; --i)
+    strides[i - 2] = Index(strides[i - 1]) * dims[i - 1];
+  this->strided = Strided{Index::zero(), move(strides), dims,
+      boundsOfDims(dims)};
 }
 
 MemRef::Layout::Layout(const std::vector<smt::Expr> &indVars,
@@ -1493,6 +1951,88 @@ MemRef::Layout::Layout(const std::vector<smt::Expr> &indVars,
       inbounds(indVars).implies(condition));
 }
 
+MemRef::Layout::Layout(const vector<Expr> &indVars,
+    const Strided &strided): indVars(indVars),
+    precondition(Expr::mkBool(true)), strided(strided) {
+  assert(indVars.size() == strided.strides.size());
+  assert(indVars.size() == strided.sizes.size());
+  // A rank-0 layout is accessed with a single zero index; only iterate
+  // over the strides.
+  this->mapping = [strided](const vector<Expr> &indices) -> Expr {
+    Index idx = strided.offset;
+    for (size_t i = 0; i < strided.strides.size(); ++i)
+      idx = idx + Index(strided.strides[i]) * indices[i];
+    return idx;
+  };
+  this->inbounds = [bounds = strided.bounds](const vector<Expr> &indices) {
+    Expr cond = Expr::mkBool(true);
+    for (auto &b: bounds)
+      cond = cond & evalBound(b, indices);
+    return cond;
+  };
+
+  // Find the dimensions from the largest stride. If the strides are not
+  // constant, assume that they decrease like the row-major layout.
+  vector<unsigned> order(indVars.size());
+  for (unsigned i = 0; i < order.size(); ++i)
+    order[i] = i;
+  bool isConstStride = all_of(strided.strides.begin(), strided.strides.end(),
+      [](const Expr &s) { return Index(s).asUInt().has_value(); });
+  if (isConstStride) {
+    stable_sort(order.begin(), order.end(), [&strided](unsigned a, unsigned b) {
+      return *Index(strided.strides[a]).asUInt() >
+          *Index(strided.strides[b]).asUInt();
+    });
+  }
+
+  // Dividing by the strides in this order yields the indices if each stride
+  // is positive and not smaller than the extent of the next dimension, i.e.,
+  // the layout does not overlap.
+  // The extent is computed in 2 * Index::BITS bits so that it does not wrap
+  // around.
+  Expr noOverlap = Expr::mkBool(true);
+  for (unsigned j = 0; j < order.size(); ++j) {
+    Index stride = strided.strides[order[j]];
+    noOverlap = noOverlap & Index::zero().ult(stride);
+    if (j + 1 < order.size()) {
+      Expr next = ((Expr)strided.strides[order[j + 1]]).zext(Index::BITS);
+      Expr size = ((Expr)strided.sizes[order[j + 1]]).zext(Index::BITS);
+      noOverlap = noOverlap &
+          !((Expr)stride).zext(Index::BITS).ult(next * size);
+    }
+  }
+  noOverlap = noOverlap.simplify();
+
+  auto closedForm = [strided, order](const Expr &idx) {
+    vector<Expr> indices(order.size(), Index::zero());
+    Index rem = Index(idx) - strided.offset;
+    for (unsigned i: order) {
+      indices[i] = rem.udiv(strided.strides[i]);
+      rem = rem.urem(strided.strides[i]);
+    }
+    return indices;
+  };
+
+  if (noOverlap.isTrue()) {
+    this->inverseMappings = closedForm;
+    return;
+  }
+
+  // The layout may overlap; use the uninterpreted inverse functions
+  // otherwise.
+  Layout ufLayout(indVars, mapping, inbounds);
+  auto uninterpreted = ufLayout.inverseMappings;
+  this->inverseMappings = [closedForm, uninterpreted, noOverlap](
+      const Expr &idx) {
+    auto indices = closedForm(idx);
+    auto fallback = uninterpreted(idx);
+    for (size_t i = 0; i < indices.size(); ++i)
+      indices[i] = Expr::mkIte(noOverlap, indices[i], fallback[i]);
+    return indices;
+  };
+  this->precondition = noOverlap | ufLayout.precondition;
+}
+
 MemRef::MemRef(Memory *m,
   const mlir::Type &elemTy,
   const smt::Expr &bid,
@@ -1564,14 +2104,20 @@ MemRef::Layout MemRef::getLayout(
       mlir::getStridesAndOffset(memRefTy, strides, offset);
   assert(succeeded(success) && "unexpected non-strided memref");
 
-  auto layoutFn = [strides, offset, getConstOrFreshVar](auto &indices) {
-    Expr layout = getConstOrFreshVar(offset, "offset");
-    for (size_t i = 0; i < strides.size(); i ++)
-      layout = layout + getConstOrFreshVar(strides[i], "strides") * indices[i];
-    return layout;
-  };
-  return MemRef::Layout(Index::boundIndexVars(strides.size()),
-    layoutFn, [dims](auto &indices) { return fitsInDims(indices, dims); });
+  if (strides.size() != dims.size()) {
+    // A rank-0 memref has a single dimension of size 1.
+    auto layoutFn = [ofs = getConstOrFreshVar(offset, "offset")](
+        auto &indices) { return ofs; };
+    return MemRef::Layout(Index::boundIndexVars(dims.size()),
+      layoutFn, [dims](auto &indices) { return fitsInDims(indices, dims); });
+  }
+
+  MemRef::Layout::Strided strided{getConstOrFreshVar(offset, "offset"), {},
+      dims, boundsOfDims(dims)};
+  for (auto stride: strides)
+    strided.strides.push_back(getConstOrFreshVar(stride, "strides"));
+
+  return MemRef::Layout(Index::boundIndexVars(strides.size()), strided);
 }
 
 Expr MemRef::get(const vector<Expr> &indices) const {
@@ -1656,7 +2202,7 @@ void MemRef::setWritable(bool writable) {
 }
 
 bool MemRef::isIdentityMap() const {
-  return layout.precondition.isTrue();
+  return layout.isIdentity;
 }
 
 MemRef MemRef::subview(const vector<Expr> &offsets,
@@ -1688,7 +2234,7 @@ MemRef MemRef::subview(const vector<Expr> &offsets,
   }
 }
 
-MemRef MemRef::reshape(const std::vector<smt::Expr> &newDims) {
+MemRef MemRef::reshape(const std::vector<smt::Expr> &newDims) const {
   // Currently we support identity map only.
   assert (isIdentityMap());
 
@@ -1696,6 +2242,98 @@ MemRef MemRef::reshape(const std::vector<smt::Expr> &newDims) {
     newDims, MemRef::Layout(newDims), Expr::mkBool(true));
 }
 
+optional<MemRef> MemRef::expandShape(const vector<Expr> &newDims,
+    const vector<vector<unsigned>> &groups) const {
+  if (isIdentityMap())
+    return reshape(newDims);
+  if (!layout.strided)
+    return nullopt;
+
+  auto &src = *layout.strided;
+  assert(groups.size() == src.strides.size());
+  // Splits a coefficient of a source dimension into the coefficients of its
+  // group, like the row-major strides.
+  auto split = [&newDims, &groups](const vector<Expr> &coeffs) {
+    vector<Expr> res(newDims.size(), Index::zero());
+    for (size_t i = 0; i < groups.size(); ++i) {
+      Index c = coeffs[i];
+      for (size_t k = groups[i].size(); k > 0; --k) {
+        res[groups[i][k - 1]] = c;
+        c = c * newDims[groups[i][k - 1]];
+      }
+    }
+    return res;
+  };
+
+  Layout::Strided res{src.offset, split(src.strides), newDims, {}};
+  for (auto &b: src.bounds)
+    addBound(res.bounds, {b.offset, split(b.coeffs), b.size});
+  for (auto &b: boundsOfDims(newDims))
+    addBound(res.bounds, move(b));
+
+  return MemRef(m, elemType, bid, offset, newDims,
+      Layout(Index::boundIndexVars(newDims.size()), res), Expr::mkBool(true));
+}
+
+optional<MemRef> MemRef::collapseShape(const vector<Expr> &newDims,
+    const vector<vector<unsigned>> &groups) const {
+  if (isIdentityMap())
+    return reshape(newDims);
+  if (!layout.strided || groups.size() != newDims.size())
+    return nullopt;
+
+  auto &src = *layout.strided;
+  // sum_k coeffs[group[k]] * d_k is coeffs[group.back()] * (the merged index)
+  // if each coefficient is the next one times the size of its dimension.
+  auto merge = [this, &groups](const vector<Expr> &coeffs)
+      -> optional<vector<Expr>> {
+    vector<Expr> res;
+    for (auto &group: groups) {
+      for (size_t k = 0; k + 1 < group.size(); ++k) {
+        auto next = Index(coeffs[group[k + 1]]) * dims[group[k + 1]];
+        if (!(Index(coeffs[group[k]]) == next).simplify().isTrue())
+          return nullopt;
+      }
+      res.push_back(coeffs[group.back()]);
+    }
+    return res;
+  };
+  // Whether b is d_j < dims[j]; it holds for any merged index in bounds.
+  auto isBoundOfDim = [this](const Layout::Bound &b) {
+    if (Index(b.offset).asUInt() != 0)
+      return false;
+    optional<size_t> dim;
+    for (size_t j = 0; j < b.coeffs.size(); ++j) {
+      auto c = Index(b.coeffs[j]).asUInt();
+      if (c == 0)
+        continue;
+      if (c != 1 || dim)
+        return false;
+      dim = j;
+    }
+    return dim && (Index(b.size) == dims[*dim]).simplify().isTrue();
+  };
+
+  auto strides = merge(src.strides);
+  if (!strides)
+    return nullopt;
+
+  Layout::Strided res{src.offset, move(*strides), newDims, {}};
+  for (auto &b: src.bounds) {
+    if (isBoundOfDim(b))
+      continue;
+    auto coeffs = merge(b.coeffs);
+    if (!coeffs)
+      return nullopt;
+    addBound(res.bounds, {b.offset, move(*coeffs), b.size});
+  }
+  for (auto &b: boundsOfDims(newDims))
+    addBound(res.bounds, move(b));
+
+  return MemRef(m, elemType, bid, offset, newDims,
+      Layout(Index::boundIndexVars(newDims.size()), res), Expr::mkBool(true));
+}
+
 MemRef MemRef::mkIte(smt::Expr cond,
     const MemRef &trueValue, const MemRef &falseValue) {
   auto trueDims = trueValue.getDims();
@@ -1796,6 +2434,47 @@ MemRef::Layout MemRef::createSubViewLayout(
   };
 
   auto oldLayout = this->layout;
+  if (oldLayout.strided) {
+    // offsets[i] * oldStrides[i] moves to the offset, and strides[i] scales
+    // oldStrides[i]. The reduced dimensions are dropped.
+    auto &oldStrided = *oldLayout.strided;
+    auto isReduced = [&zeroOffsets](unsigned i) {
+      return find(zeroOffsets.begin(), zeroOffsets.end(), i) !=
+          zeroOffsets.end();
+    };
+    Index newOffset = oldStrided.offset;
+    Layout::Strided newStrided{Index::zero(), {}, {}, {}};
+    for (unsigned i = 0; i < numVarsBefore; ++i) {
+      newOffset = newOffset + Index(offsets[i]) * oldStrided.strides[i];
+      if (isReduced(i))
+        continue;
+      newStrided.strides.push_back(
+          Index(strides[i]) * oldStrided.strides[i]);
+      newStrided.sizes.push_back(sizes[i]);
+    }
+    newStrided.offset = newOffset;
+
+    // The bounds of the source are rewritten in the same way, and the new
+    // indices must fit in sizes.
+    for (auto &b: oldStrided.bounds) {
+      Index ofs = b.offset;
+      vector<Expr> coeffs;
+      for (unsigned i = 0; i < numVarsBefore; ++i) {
+        ofs = ofs + Index(b.coeffs[i]) * offsets[i];
+        if (!isReduced(i))
+          coeffs.push_back(Index(b.coeffs[i]) * strides[i]);
+      }
+      addBound(newStrided.bounds, {ofs, move(coeffs), b.size});
+    }
+    for (unsigned i = 0, j = 0; i < numVarsBefore; ++i) {
+      vector<Expr> coeffs(indVars.size(), Index::zero());
+      if (!isReduced(i))
+        coeffs[j++] = Index::one();
+      addBound(newStrided.bounds, {Index::zero(), move(coeffs), sizes[i]});
+    }
+    return Layout(indVars, newStrided);
+  }
+
   auto transformedInbounds = [=](const vector<Expr> &idxs) {
     auto idxsOrZero = insertZeros(idxs);
     auto originalIndices = transformIndices(idxsOrZero);
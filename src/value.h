@@ -118,6 +118,18 @@ class Tensor: public ShapedValue {
   // Index -> bool; Getting an uninitialized element is UB.
   smt::Expr initialized;
 
+  // If this tensor is an index remapping of another tensor (a transpose, a
+  // slice, ...), this[indVars] = baseArr[to1DIdx(baseIdxs, baseDims)].
+  // get() uses it so that a chain of views reads the base array directly
+  // instead of going through one lambda per view.
+  struct View {
+    smt::Expr baseArr;
+    std::vector<smt::Expr> baseDims;
+    std::vector<smt::Expr> indVars;
+    std::vector<smt::Expr> baseIdxs;
+  };
+  std::optional<View> view;
+
   Tensor(mlir::Type elemType, std::vector<smt::Expr> &&dims, smt::Expr &&arr,
          smt::Expr &&initialized):
       ShapedValue(elemType), dims(std::move(dims)), arr(std::move(arr)),
@@ -127,6 +139,10 @@ public:
   static inline unsigned MAX_TENSOR_SIZE;
   static inline unsigned MAX_DIM_SIZE;
   static inline unsigned MAX_CONST_SIZE; // -1 if unbounded
+  // Fresh tensors whose static size is at most this are encoded as lambdas
+  // over scalar variables, and their refinement is checked element by
+  // element. 0 if disabled.
+  static inline unsigned MAX_SCALARIZE_SIZE = 0;
 
   // A splat tensor.
   Tensor(mlir::Type elemType, smt::Expr &&splat_elem,
@@ -170,6 +186,16 @@ public:
       std::vector<smt::Expr> srcidxs,
       std::vector<smt::Expr> &&newsizes) const;
 
+  // Return a new tensor T2 of shape newdims s.t.
+  //   T2[indVars] = this[srcIdxs]
+  // Unlike affine(), indVars must be bound index variables and srcIdxs is
+  // composed with the index map of this tensor if this is a view as well.
+  // It is assumed that this tensor is initialized. The returned tensor
+  // is fully initialized.
+  Tensor remap(std::vector<smt::Expr> &&newdims,
+      std::vector<smt::Expr> &&indVars,
+      const std::vector<smt::Expr> &srcIdxs) const;
+
   // Concatenates this and t2 along a given axis.
   // ex) If this: <2x3xf32>, t2:<2x5xf32> and axis = 1, the result is a tensor
   //     of size <2x8xf32>.
@@ -290,6 +316,10 @@ public:
   // A constant tensor from mlir::ElementsAttr and a static shape.
   static Tensor fromElemsAttr(mlir::RankedTensorType tensorTy,
       mlir::ElementsAttr attr);
+  // The number of runs of equal elements that fromElemsAttr encodes for a
+  // non-splat dense attr, or nullopt if it is more than MAX_CONST_SIZE.
+  static std::optional<uint64_t> getConstEncodingSize(
+      mlir::DenseElementsAttr attr);
 
   // A fresh tensor.
   static Tensor var(mlir::Type elemType, std::string &&name,
@@ -302,9 +332,18 @@ public:
   // this: tgt, other: src
   std::pair<smt::Expr, std::vector<smt::Expr>> refines(
       const Tensor &other) const;
+  // Partition the index space of refines() into at most maxBoxes boxes, and
+  // return a cube per box over the unbound index variable (params).
+  // The boxes at the boundary of each dimension come first.
+  // Returns an empty vector if the shape is not static.
+  std::vector<smt::Expr> splitRefinement(const std::vector<smt::Expr> &params,
+      unsigned maxBoxes) const;
   Tensor eval(smt::Model m) const;
 
 private:
+  // Return the static size if this tensor is encoded element by element.
+  std::optional<uint64_t> getScalarizedSize() const;
+
   smt::Expr to1DArrayWithOfs(
       const std::vector<smt::Expr> &offbegins,
       const std::vector<smt::Expr> &sizes) const;
@@ -348,18 +387,47 @@ public:
     //     inverse0(mapping(d0, d1)) = d0 && inverse1(mapping(d0, d1)) = d1
     smt::Expr precondition;
 
+    // An affine inbounds condition
+    // ex) offset + d0 * coeffs[0] + d1 * coeffs[1] < size
+    struct Bound {
+      smt::Expr offset;
+      std::vector<smt::Expr> coeffs;
+      smt::Expr size;
+    };
+    // A strided layout
+    // ex) (d0, d1) -> offset + d0 * strides[0] + d1 * strides[1]
+    //     where d0 < sizes[0] and d1 < sizes[1]
+    struct Strided {
+      smt::Expr offset;
+      std::vector<smt::Expr> strides;
+      std::vector<smt::Expr> sizes;
+      // The inbounds condition is the conjunction of these. Subviews and
+      // reshapes rewrite the bounds of the source instead of wrapping its
+      // inbounds function.
+      std::vector<Bound> bounds;
+    };
+    // Set if the layout is strided. Its inverseMappings are then defined with
+    // udiv and urem, without quantifiers, if the strides provably do not
+    // overlap (without overflow in their extents). Otherwise they fall back
+    // to the uninterpreted inverse functions.
+    std::optional<Strided> strided;
+    bool isIdentity = false;
+
     Layout(const std::vector<smt::Expr> &dims);
 
     Layout(const std::vector<smt::Expr> &indVars,
         const Fn &layout,    // (i, j, k) -> block offset
         const Fn &inbounds);
 
+    Layout(const std::vector<smt::Expr> &indVars, const Strided &strided);
+
     // MARK(makesource)
     // Without this copy constructor, I encounter libc+abi.dylib related error in MacOS
     Layout(const Layout& copy):
       indVars(copy.indVars), inbounds(copy.inbounds),
       mapping(copy.mapping), inverseMappings(copy.inverseMappings),
-      precondition(copy.precondition) {}
+      precondition(copy.precondition), strided(copy.strided),
+      isIdentity(copy.isIdentity) {}
 
     std::vector<smt::Expr> getInverseIndices(const smt::Expr &idx) const;
   };
@@ -433,7 +501,18 @@ public:
 
   // Return a new memref with new dimensions.
   // The memref created here is a view reference
-  MemRef reshape(const std::vector<smt::Expr> &newDims);
+  MemRef reshape(const std::vector<smt::Expr> &newDims) const;
+  // Return a new memref whose i-th dimension is split into the dimensions
+  // groups[i] of newDims (memref.expand_shape).
+  // Returns nullopt if the layout is neither the identity nor strided.
+  std::optional<MemRef> expandShape(const std::vector<smt::Expr> &newDims,
+      const std::vector<std::vector<unsigned>> &groups) const;
+  // Return a new memref whose i-th dimension merges the dimensions groups[i]
+  // (memref.collapse_shape).
+  // Returns nullopt if the layout is neither the identity nor strided, or
+  // the dimensions of a group are not contiguous.
+  std::optional<MemRef> collapseShape(const std::vector<smt::Expr> &newDims,
+      const std::vector<std::vector<unsigned>> &groups) const;
 
   // Returns (cond ? trueValue : falseValue).
   // It is assumed that trueValue.layout is equivalent to falseValue.layout.
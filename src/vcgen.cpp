@@ -12,15 +12,19 @@
 #include "analysis.h"
 
 #include "magic_enum.hpp"
+#include "llvm/Support/MathExtras.h"
+#include <algorithm>
 #include <chrono>
 #include <fstream>
 #include <functional>
+#include <iterator>
 #include <map>
 #include <optional>
 #include <sstream>
 #include <variant>
 #include <vector>
 #include <queue>
+#include <thread>
 
 using namespace smt;
 using namespace std;
@@ -39,11 +43,18 @@ public:
   mlir::FuncOp src, tgt;
   string dumpSMTPath;
 
-  TypeMap<size_t> numBlocksPerType;
+  TypeMap<size_t> numBlocksPerType; // # of global blocks
+  TypeMap<size_t> numLocalBlocksPerType; // max. # of local blocks
   unsigned int f32NonConstsCount, f64NonConstsCount;
   set<llvm::APFloat> f32Consts, f64Consts;
+  // constants used only by unobservable ops in both src and tgt
+  set<llvm::APFloat> f32UnobservedConsts, f64UnobservedConsts;
   bool f32HasInfOrNaN, f64HasInfOrNaN;
   vector<mlir::memref::GlobalOp> globals;
+  // memref arguments that are read-only in both src and tgt
+  set<unsigned> readOnlyMemRefArgs;
+  // element types of the global blocks that src or tgt may write
+  llvm::DenseSet<mlir::Type> writtenGlobalTypes;
   bool isFpAddAssociative;
   bool unrollIntSum; // sum(arr) := arr[0] + ... + arr[arr.len-1]
   bool useMultisetForFpSum;
@@ -78,6 +89,78 @@ llvm::cl::opt<string> arg_dump_smt_to("dump-smt-to",
   llvm::cl::desc("Dump SMT queries to"), llvm::cl::value_desc("path"),
   llvm::cl::cat(MlirTvCategory));
 
+llvm::cl::opt<bool> arg_smt_tactic_benchmark("smt-tactic-benchmark",
+  llvm::cl::desc("Also run each SMT query with Z3's default solver and print"
+                 " the running times of both (use with -smt-tactic and"
+                 " --verbose)"), llvm::cl::Hidden,
+  llvm::cl::init(false),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<bool> split_memory_query("split-memory-query",
+  llvm::cl::desc("Split the memory refinement check into sub-queries per"
+                 " block id (and offset range if the block size is constant),"
+                 " and solve them in parallel"),
+  llvm::cl::init(false),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<unsigned> split_offset_ranges("split-offset-ranges",
+  llvm::cl::desc("The maximum number of offset ranges per memory block when"
+                 " -split-memory-query is given (default=4)"),
+  llvm::cl::init(4), llvm::cl::value_desc("number"),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<bool> split_retval_query("split-retval-query",
+  llvm::cl::desc("Split the refinement check of each returned tensor into"
+                 " sub-queries over boxes of its index space, and solve them"
+                 " in parallel (boundary boxes first)"),
+  llvm::cl::init(false),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<unsigned> split_retval_boxes("split-retval-boxes",
+  llvm::cl::desc("The maximum number of boxes per returned tensor when"
+                 " -split-retval-query is given (default=27)"),
+  llvm::cl::init(27), llvm::cl::value_desc("number"),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<bool> split_ub_query("split-ub-query",
+  llvm::cl::desc("Split the UB check into sub-queries per target operation,"
+                 " and solve them in parallel"),
+  llvm::cl::init(false),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<bool> beta_reduce("beta-reduce",
+  llvm::cl::desc("Beta-reduce select(lambda) terms of each query before"
+                 " solving it"),
+  llvm::cl::init(false),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<unsigned> scalarize_tensor_size("scalarize-tensor-size",
+  llvm::cl::desc("Encode fresh tensors having at most this many elements"
+                 " with scalar variables, and solve array-free queries in"
+                 " QF_UFBV (default=0, disabled)"),
+  llvm::cl::init(0), llvm::cl::value_desc("number"),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<unsigned> expand_quantifiers("expand-quantifiers",
+  llvm::cl::desc("Expand forall quantifiers whose bound variables have at"
+                 " most this many values in total into conjunctions, and"
+                 " solve queries that become quantifier-free in QF_AUFBV"
+                 " (default=0, disabled)"),
+  llvm::cl::init(0), llvm::cl::value_desc("number"),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<bool> slice_queries("slice-queries",
+  llvm::cl::desc("Include only the well-definedness of operations that the"
+                 " return value or memory depends on in its refinement query"),
+  llvm::cl::init(false),
+  llvm::cl::cat(MlirTvCategory));
+
+llvm::cl::opt<unsigned> split_threads("split-threads",
+  llvm::cl::desc("The number of threads solving split sub-queries"
+                 " (default=0, the number of hardware threads)"),
+  llvm::cl::init(0), llvm::cl::value_desc("number"),
+  llvm::cl::cat(MlirTvCategory));
+
 llvm::cl::opt<bool> arg_smt_use_all_logic("smt-use-all-logic",
   llvm::cl::desc("Use ALL Logic for SMT"),
   llvm::cl::init(false),
@@ -107,6 +190,13 @@ llvm::cl::opt<unsigned int> max_unknown_dimsize("max-unknown-dimsize",
   llvm::cl::init(50), llvm::cl::value_desc("number"),
   llvm::cl::cat(MlirTvCategory));
 
+llvm::cl::opt<unsigned> index_bits("index-bits",
+  llvm::cl::desc("The bitwidth of index values (default=0, the smallest"
+                 " width that fits the shapes, or 32 if index values are"
+                 " computed by arithmetic)"),
+  llvm::cl::init(0), llvm::cl::value_desc("number"),
+  llvm::cl::cat(MlirTvCategory));
+
 llvm::cl::opt<unsigned int> max_tensor_size("max-tensor-size",
   llvm::cl::desc("Specify the maximum number of elements of a dynamically"
       " sized tensor tensor."),
@@ -116,7 +206,8 @@ llvm::cl::opt<unsigned int> max_tensor_size("max-tensor-size",
 llvm::cl::opt<int> max_const_tensor_size("max-const-tensor-size",
   llvm::cl::desc("Specify the maximum number of elements of a constant tensor"
       " that mlir-tv is going to encode precisely."
-      "Any non-splat constant tensor having more elements than this will be"
+      " Runs of equal elements and repeated rows count as one element."
+      " Any non-splat constant tensor having more elements than this will be"
       " encoded as a fully unknown array, possibly introducing validation"
       " failures."
       " If set to -1, there is no such limit."),
@@ -161,12 +252,29 @@ static optional<string> checkFunctionSignatures(
   return {};
 }
 
+// Return true if the memref arguments i and j can be assumed to point to
+// different blocks. isTypeWritten is true if src or tgt may write a global
+// block of their element type.
+static bool canAssumeNoAlias(mlir::FuncOp fn, unsigned i, unsigned j,
+    const set<unsigned> &readOnlyArgs, bool isTypeWritten) {
+  // Aliasing between read-only arguments is not observable unless another
+  // memref may write the blocks they point to.
+  if (!isTypeWritten && readOnlyArgs.count(i) && readOnlyArgs.count(j))
+    return true;
+
+  return fn.getArgAttr(i, "llvm.noalias") || fn.getArgAttr(j, "llvm.noalias");
+}
+
 static State createInputState(
     mlir::FuncOp fn, std::unique_ptr<Memory> &&initMem,
-    ArgInfo &args, vector<Expr> &preconds) {
+    const set<unsigned> &readOnlyArgs,
+    const llvm::DenseSet<mlir::Type> &writtenGlobalTypes, ArgInfo &args,
+    vector<Expr> &preconds) {
   State s(move(initMem));
   unsigned n = fn.getNumArguments();
   TypeMap<unsigned> numMemRefArgs;
+  // element type -> (arg index, bid) of memref arguments
+  TypeMap<vector<pair<unsigned, Expr>>> memrefArgBids;
 
   for (unsigned i = 0; i < n; ++i) {
     auto arg = fn.getArgument(i);
@@ -214,6 +322,17 @@ static State createInputState(
         s.addPrecondition(((Expr)memref.getOffset()).isZero());
         unsigned constBID = numMemRefArgs[ty.getElementType()]++;
         s.addPrecondition(memref.getBID() == constBID);
+      } else {
+        auto &bids = memrefArgBids[ty.getElementType()];
+        for (auto &[j, bid]: bids) {
+          if (canAssumeNoAlias(fn, j, i, readOnlyArgs,
+                writtenGlobalTypes.contains(ty.getElementType()))) {
+            verbose("createInputState") << "Assuming that arg " << j
+                << " and arg " << i << " do not alias\n";
+            preconds.push_back(bid != memref.getBID());
+          }
+        }
+        bids.emplace_back(i, memref.getBID());
       }
 
       // Function argument MemRefs must point to global memblocks.
@@ -249,11 +368,80 @@ static State createInputState(
   return s;
 }
 
+static const char *SMT_LOGIC_QF  = "QF_AUFBV";
+static const char *SMT_LOGIC     = "AUFBV";
+static const char *SMT_LOGIC_ALL = "ALL";
+// Floating-point operations are encoded with uninterpreted functions.
+static const char *SMT_LOGIC_QF_BV = "QF_UFBV";
+
+// simplify() beta-reduces the selects from the shared fp add/mul ladders,
+// which would put a copy of a ladder at every fp op back into the query.
+static Expr simplifyQuery(const Expr &e) {
+  return aop::hasSharedFpLadders() ? e : e.simplify();
+}
+
+static Expr reduceQuery(const Expr &query, const string &name) {
+  Expr reduced = query;
+  // Scalarized tensors are lambdas; reduce them away as well.
+  if (beta_reduce || scalarize_tensor_size) {
+    auto sizeBefore = reduced.getDAGSize();
+    reduced = reduced.betaReduce();
+    verbose("beta-reduce") << name << ": " << sizeBefore << " -> "
+        << reduced.getDAGSize() << " nodes\n";
+  } else if (isVerbose() && aop::hasSharedFpLadders()) {
+    auto size = reduced.getDAGSize();
+    auto inlinedSize = reduced.betaReduce().getDAGSize();
+    verbose("fpLadder") << name << ": sharing the fp ladders saves "
+        << (size < inlinedSize ? "nodes: " : "no nodes: ") << inlinedSize
+        << " -> " << size << "\n";
+  }
+
+  if (expand_quantifiers) {
+    unsigned numExpanded = 0;
+    reduced = reduced.expandForalls(expand_quantifiers, numExpanded);
+    if (numExpanded)
+      verbose("expand-quantifiers") << name << ": expanded " << numExpanded
+          << " foralls\n";
+  }
+  return reduced;
+}
+
+// Switch the empty solver to a cheaper logic if the rewritten query and cubes
+// do not need the current one: a pure bit-vector logic if they do not have
+// arrays and quantifiers, or QF_AUFBV if the quantifiers were expanded.
+static void useCheaperLogicIfPossible(Solver &solver, const Expr &query,
+    const vector<Expr> &cubes, const string &name) {
+  auto forAll = [&](auto pred) {
+    return pred(query) && all_of(cubes.begin(), cubes.end(), pred);
+  };
+
+  // Only downgrade the default logics, not a logic chosen by the user
+  // (-smt-use-all-logic).
+  const string curLogic = solver.getLogic();
+  if (curLogic != SMT_LOGIC && curLogic != SMT_LOGIC_QF)
+    return;
+
+  const char *logic = nullptr;
+  if (scalarize_tensor_size && forAll([](const Expr &e) {
+        return e.isArrayAndQuantifierFree(); }))
+    logic = SMT_LOGIC_QF_BV;
+  else if (expand_quantifiers && curLogic == SMT_LOGIC &&
+           forAll([](const Expr &e) { return !e.hasQuantifier(); }))
+    logic = SMT_LOGIC_QF;
+
+  if (!logic)
+    return;
+  verbose("useCheaperLogic") << name << ": use logic " << logic << "\n";
+  solver.reset(logic);
+}
+
 static pair<CheckResult, int64_t> solve(
     Solver &solver, const Expr &refinement_negated,
     const string &dumpSMTPath, const string &dump_string_to_suffix) {
   //solver.reset();
-  solver.add(refinement_negated);
+  auto query = reduceQuery(refinement_negated, dump_string_to_suffix);
+  useCheaperLogicIfPossible(solver, query, {}, dump_string_to_suffix);
+  solver.add(query);
 
   if (!dumpSMTPath.empty()) {
 #if SOLVER_Z3
@@ -278,12 +466,92 @@ static pair<CheckResult, int64_t> solve(
       chrono::duration_cast<chrono::milliseconds>(
         chrono::system_clock::now() - startTime).count();
 
+#if SOLVER_Z3
+  if (arg_smt_tactic_benchmark && solver.z3 && !getTactic().empty()) {
+    // Solve the same query with the default solver for comparison.
+    z3::solver defaultSolver(solver.z3->ctx(), solver.getLogic());
+    defaultSolver.add(solver.z3->assertions());
+
+    auto startTimeDefault = chrono::system_clock::now();
+    auto defaultResult = defaultSolver.check();
+    auto elapsedMillisecDefault =
+        chrono::duration_cast<chrono::milliseconds>(
+          chrono::system_clock::now() - startTimeDefault).count();
+
+    auto resultStr = result.hasSat() ? "sat" :
+        (result.hasUnsat() ? "unsat" : "unknown");
+    auto defaultResultStr = defaultResult == z3::sat ? "sat" :
+        (defaultResult == z3::unsat ? "unsat" : "unknown");
+    verbose("tactic") << dump_string_to_suffix << " (" << solver.getLogic()
+        << "): '" << getTactic() << "' " << elapsedMillisec << "ms ("
+        << resultStr << "), default " << elapsedMillisecDefault << "ms ("
+        << defaultResultStr << ")\n";
+  }
+#endif
+
   return {result, elapsedMillisec};
 }
 
-static const char *SMT_LOGIC_QF  = "QF_AUFBV";
-static const char *SMT_LOGIC     = "AUFBV";
-static const char *SMT_LOGIC_ALL = "ALL";
+// Solve refinement_negated by splitting it into cubes (see
+// Solver::checkSplit). satCube is the index of the cube having a
+// counterexample.
+static pair<CheckResult, int64_t> solveSplit(
+    Solver &solver, const Expr &refinement_negated, const vector<Expr> &cubes,
+    const string &dumpSMTPath, const string &dump_string_to_suffix,
+    optional<size_t> &satCube) {
+  auto query = reduceQuery(refinement_negated, dump_string_to_suffix);
+  useCheaperLogicIfPossible(solver, query, cubes, dump_string_to_suffix);
+  solver.add(query);
+
+#if SOLVER_Z3
+  if (!dumpSMTPath.empty() && refinement_negated.hasZ3Expr() && solver.z3) {
+    for (size_t i = 0; i < cubes.size(); ++i) {
+      ofstream fout(dumpSMTPath + ".z3." + dump_string_to_suffix + ".cube" +
+          to_string(i) + ".smt2");
+      z3::solver s(solver.z3->ctx());
+      s.add(solver.z3->assertions());
+      s.add(cubes[i].getZ3Expr());
+      fout << s.to_smt2();
+      fout.close();
+    }
+  }
+#endif
+
+  unsigned numThreads = split_threads ?
+      split_threads.getValue() : max(1u, thread::hardware_concurrency());
+  auto startTime = chrono::system_clock::now();
+  CheckResult result = solver.checkSplit(cubes, numThreads, satCube);
+  auto elapsedMillisec =
+      chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now() - startTime).count();
+
+  verbose("solveSplit") << dump_string_to_suffix << ": " << cubes.size()
+      << " cubes, " << numThreads << " threads, " << elapsedMillisec << "ms\n";
+  return {result, elapsedMillisec};
+}
+
+// Solve the query with the sliced well-definedness first. It is weaker than
+// the whole well-definedness, so unsat is conclusive. Otherwise, solve the
+// query again with the whole one to avoid reporting UB outside of the slice.
+static pair<CheckResult, int64_t> solveSliced(Solver &s,
+    function<pair<CheckResult, int64_t>(const Expr &)> solveWith,
+    const Expr &wellDefined, const optional<Expr> &slicedWellDefined) {
+  if (!slicedWellDefined)
+    return solveWith(wellDefined);
+
+  // The sliced query may have switched the solver to a bit-vector logic.
+  string logic = s.getLogic();
+  auto res = solveWith(*slicedWellDefined);
+  if (res.first.hasUnsat() || res.first.isInconsistent())
+    return res;
+
+  verbose("solveSliced") << "The sliced query is not unsat; solving it again"
+      " with the whole well-definedness\n";
+  s.reset(logic.c_str());
+  auto res2 = solveWith(wellDefined);
+  res2.second += res.second;
+  return res2;
+}
 
 static Results checkRefinement(
     const ValidationInput &vinput,
@@ -322,10 +590,26 @@ static Results checkRefinement(
   { // 1. Check UB
     verbose("checkRefinement") << "1. Check UB\n";
     Solver s(logic);
-    auto not_refines =
-        (st_src.isWellDefined() & !st_tgt.isWellDefined()).simplify();
-    auto res = solve(s, precond & not_refines, vinput.dumpSMTPath,
-                     fnname + ".1.ub");
+    // With -split-ub-query, one cube per target op: !(tgt op is well-defined)
+    vector<mlir::Operation *> tgtOps;
+    vector<Expr> cubes;
+    if (split_ub_query) {
+      tgt.walk([&](mlir::Operation *op) {
+        auto opWellDefined = simplifyQuery(st_tgt.isOpWellDefined(op));
+        if (opWellDefined.isTrue())
+          return;
+        tgtOps.push_back(op);
+        cubes.push_back(!opWellDefined);
+      });
+    }
+
+    optional<size_t> satCube;
+    auto res = cubes.empty() ?
+        solve(s, precond &
+            simplifyQuery(st_src.isWellDefined() & !st_tgt.isWellDefined()),
+            vinput.dumpSMTPath, fnname + ".1.ub") :
+        solveSplit(s, precond & simplifyQuery(st_src.isWellDefined()), cubes,
+            vinput.dumpSMTPath, fnname + ".1.ub", satCube);
     elapsedMillisec += res.second;
     if (res.first.isInconsistent()) {
       llvm::outs() << "== Result: inconsistent output!!"
@@ -334,6 +618,9 @@ static Results checkRefinement(
     } else if (!res.first.hasUnsat()) {
       printErrorMsg(s, res.first, "Source is more defined than target", {},
                     VerificationStep::UB);
+      if (satCube)
+        llvm::outs() << "Target operation having undefined behavior: "
+                     << *tgtOps[*satCube] << "\n";
       return res.first.hasSat() ? Results::UB : Results::TIMEOUT;
     }
   }
@@ -348,11 +635,35 @@ static Results checkRefinement(
       auto [refines, params] =
           ::refines(st_tgt.retValues[i], st_src.retValues[i]);
 
-      auto not_refines =
-        (st_src.isWellDefined() & st_tgt.isWellDefined() & !refines)
-        .simplify();
-      auto res = solve(s, precond & not_refines, vinput.dumpSMTPath,
-                      fnname + ".2.retval." + to_string(i));
+      // Structured bindings cannot be captured by lambdas in C++17
+      Expr neg_refines = !refines;
+      auto wellDefined = st_src.isWellDefined() & st_tgt.isWellDefined();
+      optional<Expr> slicedWellDefined;
+      if (slice_queries) {
+        auto srcRet = src.getBody().front().getTerminator()->getOperand(i);
+        auto tgtRet = tgt.getBody().front().getTerminator()->getOperand(i);
+        slicedWellDefined =
+            st_src.isWellDefined(getBackwardSlice(src, srcRet)) &
+            st_tgt.isWellDefined(getBackwardSlice(tgt, tgtRet));
+      }
+      auto suffix = fnname + ".2.retval." + to_string(i);
+      vector<Expr> cubes;
+      if (split_retval_query) {
+        if (auto *t = get_if<Tensor>(&st_tgt.retValues[i]);
+            t && !params.empty())
+          cubes = t->splitRefinement(params, split_retval_boxes);
+      }
+
+      auto solveWith = [&](const Expr &wd) {
+        auto not_refines = simplifyQuery(wd & neg_refines);
+        if (cubes.empty())
+          return solve(s, precond & not_refines, vinput.dumpSMTPath, suffix);
+
+        optional<size_t> satCube;
+        return solveSplit(s, precond & not_refines, cubes, vinput.dumpSMTPath,
+            suffix, satCube);
+      };
+      auto res = solveSliced(s, solveWith, wellDefined, slicedWellDefined);
       elapsedMillisec += res.second;
 
       if (res.first.isInconsistent()) {
@@ -374,17 +685,37 @@ static Results checkRefinement(
   if (st_src.m->getTotalNumBlocks() > 0 ||
       st_tgt.m->getTotalNumBlocks() > 0) { // 3. Check memory refinement
     verbose("checkRefinement") << "3. Check memory refinement\n";
-    Solver s(logic);
     auto refinementPerType = st_tgt.m->refines(*st_src.m);
+    auto wellDefined = st_src.isWellDefined() & st_tgt.isWellDefined();
+    optional<Expr> slicedWellDefined;
+    if (slice_queries)
+      slicedWellDefined = st_src.isWellDefined(getMemorySlice(src)) &
+          st_tgt.isWellDefined(getMemorySlice(tgt));
     // [refines, params]
     for (auto &[elementType, refinement]: refinementPerType) {
+      Solver s(logic);
       Expr refines = refinement.first;
       auto &params = refinement.second;
+      if (refines.isTrue()) {
+        // Neither src nor tgt updates the memory blocks of elementType
+        verbose("checkRefinement") << "  skipped " << elementType
+            << " (never written)\n";
+        continue;
+      }
 
-      auto not_refines =
-        (st_src.isWellDefined() & st_tgt.isWellDefined() & !refines).simplify();
-      auto res = solve(s, precond & not_refines, vinput.dumpSMTPath,
-                      fnname + ".3.memory." + to_string(elementType));
+      auto suffix = fnname + ".3.memory." + to_string(elementType);
+      auto solveWith = [&](const Expr &wd) {
+        auto not_refines = simplifyQuery(wd & !refines);
+        if (!split_memory_query)
+          return solve(s, precond & not_refines, vinput.dumpSMTPath, suffix);
+
+        auto cubes = st_tgt.m->splitRefinement(*st_src.m, elementType,
+            params, split_offset_ranges);
+        optional<size_t> satCube;
+        return solveSplit(s, precond & not_refines, cubes, vinput.dumpSMTPath,
+            suffix, satCube);
+      };
+      auto res = solveSliced(s, solveWith, wellDefined, slicedWellDefined);
       elapsedMillisec += res.second;
       if (res.first.isInconsistent()) {
         llvm::outs() << "== Result: inconsistent output!!"
@@ -430,7 +761,8 @@ static State encodeFinalState(
     bool printOps, bool issrc, ArgInfo &args, vector<Expr> &preconds) {
   mlir::FuncOp fn = issrc ? vinput.src : vinput.tgt;
 
-  State st = createInputState(fn, move(initMem), args, preconds);
+  State st = createInputState(fn, move(initMem), vinput.readOnlyMemRefArgs,
+      vinput.writtenGlobalTypes, args, preconds);
 
   if (printOps)
     llvm::outs() << (issrc ? "<src>" : "<tgt>") << "\n";
@@ -459,9 +791,8 @@ static tuple<State, State, Expr> encodeFinalStates(
   ArgInfo args;
   vector<Expr> preconds;
 
-  // Set max. local blocks as num global blocks
   auto initMemSrc = make_unique<Memory>(
-      vinput.numBlocksPerType, vinput.numBlocksPerType, vinput.globals);
+      vinput.numBlocksPerType, vinput.numLocalBlocksPerType, vinput.globals);
   // Due to how CVC5 treats unbound vars, the initial memory must be precisely
   // copied
   unique_ptr<Memory> initMemTgt(initMemSrc->clone());
@@ -482,7 +813,7 @@ static tuple<State, State, Expr> encodeFinalStates(
 
   Expr precond =
       exprAnd(preconds) & st_src.precondition() & st_tgt.precondition();
-  precond = precond.simplify();
+  precond = simplifyQuery(precond);
 
   return {move(st_src), move(st_tgt), move(precond)};
 }
@@ -518,8 +849,10 @@ static void checkIsSrcAlwaysUB(
       vinput.unrollIntSum,
       no_arith_properties.getValue(),
       arg_unroll_fp_sum_bound.getValue(),
-      vinput.f32NonConstsCount, vinput.f32Consts, vinput.f32HasInfOrNaN,
-      vinput.f64NonConstsCount, vinput.f64Consts, vinput.f64HasInfOrNaN);
+      vinput.f32NonConstsCount, vinput.f32Consts,
+      vinput.f32UnobservedConsts, vinput.f32HasInfOrNaN,
+      vinput.f64NonConstsCount, vinput.f64Consts,
+      vinput.f64UnobservedConsts, vinput.f64HasInfOrNaN);
   aop::setEncodingOptions(vinput.useMultisetForFpSum);
 
   ArgInfo args_dummy;
@@ -528,7 +861,7 @@ static void checkIsSrcAlwaysUB(
   // program more undefined. (This may not be true if ptr-to-int casts exist,
   // but we don't have a plan to support that)
   auto initMemory = make_unique<Memory>(
-      vinput.numBlocksPerType, vinput.numBlocksPerType, vinput.globals,
+      vinput.numBlocksPerType, vinput.numLocalBlocksPerType, vinput.globals,
       /*blocks initially alive*/true);
   auto st = encodeFinalState(vinput, move(initMemory), false, true,
       args_dummy, preconds);
@@ -539,7 +872,7 @@ static void checkIsSrcAlwaysUB(
   verbose("checkIsSrcAlwaysUB") << "use logic: " << logic << "\n";
 
   Solver s(logic);
-  auto not_ub = st.isWellDefined().simplify();
+  auto not_ub = simplifyQuery(st.isWellDefined());
   auto smtres = solve(s, exprAnd(preconds) & not_ub, vinput.dumpSMTPath,
                       fnname + ".notub");
   elapsedMillisec += smtres.second;
@@ -612,8 +945,10 @@ static Results validate(ValidationInput vinput) {
         vinput.unrollIntSum,
         no_arith_properties.getValue(),
         arg_unroll_fp_sum_bound.getValue(),
-        vinput.f32NonConstsCount, vinput.f32Consts, vinput.f32HasInfOrNaN,
-        vinput.f64NonConstsCount, vinput.f64Consts, vinput.f64HasInfOrNaN);
+        vinput.f32NonConstsCount, vinput.f32Consts,
+        vinput.f32UnobservedConsts, vinput.f32HasInfOrNaN,
+        vinput.f64NonConstsCount, vinput.f64Consts,
+        vinput.f64UnobservedConsts, vinput.f64HasInfOrNaN);
 
     if (!dumpSMTPath.empty()) {
       vinput.dumpSMTPath = dumpSMTPath;
@@ -689,6 +1024,31 @@ static Results validate(ValidationInput vinput) {
   return result;
 }
 
+// Return the smallest index bitwidth that can represent every index value of
+// src and tgt, with one more bit so that adding two of them does not wrap.
+static unsigned getIndexBits(
+    const IndexAnalysisResult &src, const IndexAnalysisResult &tgt) {
+  if (index_bits.getValue() != 0)
+    return index_bits.getValue();
+  if (src.hasUnboundedIndex || tgt.hasUnboundedIndex)
+    return Index::DEFAULT_BITS;
+
+  uint64_t maxValue = max(src.maxStaticValue, tgt.maxStaticValue);
+  unsigned maxDynamicRank = max(src.maxDynamicRank, tgt.maxDynamicRank);
+  if (maxDynamicRank != 0) {
+    // The size of a dynamically shaped tensor is computed before it is
+    // bounded by MAX_TENSOR_SIZE.
+    uint64_t maxSize = 1;
+    for (unsigned i = 0; i < maxDynamicRank; ++i)
+      maxSize = llvm::SaturatingMultiply(maxSize,
+          (uint64_t)Tensor::MAX_DIM_SIZE);
+    maxValue = max({maxValue, maxSize, (uint64_t)Tensor::MAX_TENSOR_SIZE});
+  }
+
+  unsigned bits = maxValue == 0 ? 2 : llvm::Log2_64(maxValue) + 2;
+  return min(bits, Index::DEFAULT_BITS);
+}
+
 static vector<mlir::memref::GlobalOp> mergeGlobals(
     const map<string, mlir::memref::GlobalOp> &srcGlobals,
     const map<string, mlir::memref::GlobalOp> &tgtGlobals) {
@@ -773,6 +1133,7 @@ Results validate(
     Tensor::MAX_TENSOR_SIZE = max_tensor_size.getValue();
     Tensor::MAX_CONST_SIZE = max_const_tensor_size.getValue();
     Tensor::MAX_DIM_SIZE = max_unknown_dimsize.getValue();
+    Tensor::MAX_SCALARIZE_SIZE = scalarize_tensor_size.getValue();
     MemRef::MAX_DIM_SIZE = max_unknown_dimsize.getValue();
 
     try {
@@ -796,12 +1157,39 @@ Results validate(
     vinput.tgt = tgtfn;
     vinput.dumpSMTPath = arg_dump_smt_to.getValue();
     vinput.globals = globals;
-
+    set_intersection(src_res.memref.readOnlyArgs.begin(),
+        src_res.memref.readOnlyArgs.end(),
+        tgt_res.memref.readOnlyArgs.begin(),
+        tgt_res.memref.readOnlyArgs.end(),
+        inserter(vinput.readOnlyMemRefArgs,
+            vinput.readOnlyMemRefArgs.begin()));
+    vinput.writtenGlobalTypes = src_res.memref.writtenGlobalTypes;
+    vinput.writtenGlobalTypes.insert(tgt_res.memref.writtenGlobalTypes.begin(),
+        tgt_res.memref.writtenGlobalTypes.end());
+
+    // Global blocks are the ones that arguments or global vars point to.
     vinput.numBlocksPerType = src_res.memref.argCount;
-    for (auto &[ty, cnt]: src_res.memref.varCount)
-      vinput.numBlocksPerType[ty] += cnt;
-    for (auto &[ty, cnt]: tgt_res.memref.varCount)
-      vinput.numBlocksPerType[ty] += cnt;
+    for (auto &glb: globals)
+      vinput.numBlocksPerType[glb.type().getElementType()]++;
+    // src and tgt have their own local blocks. Since a deallocated block that
+    // is never accessed again is reused, the max. number of local blocks that
+    // are alive at the same time suffices.
+    vinput.numLocalBlocksPerType = src_res.memref.maxLiveLocalCount;
+    for (auto &[ty, cnt]: tgt_res.memref.maxLiveLocalCount) {
+      auto &n = vinput.numLocalBlocksPerType[ty];
+      n = max(n, cnt);
+    }
+    // Let both maps have all memref element types
+    for (auto *res: {&src_res, &tgt_res}) {
+      for (auto &[ty, cnt]: res->memref.varCount) {
+        vinput.numBlocksPerType[ty];
+        vinput.numLocalBlocksPerType[ty];
+      }
+    }
+    for (auto &[ty, cnt]: vinput.numBlocksPerType)
+      vinput.numLocalBlocksPerType[ty];
+    for (auto &[ty, cnt]: vinput.numLocalBlocksPerType)
+      vinput.numBlocksPerType[ty];
 
     if (vinput.numBlocksPerType.size() > 1) {
       llvm::outs() << "NOTE: mlir-tv assumes that memrefs of different element "
@@ -811,8 +1199,13 @@ Results validate(
     if (num_memblocks.getValue() != 0) {
       for (auto &[ty, cnt]: vinput.numBlocksPerType)
         cnt = num_memblocks.getValue();
+      for (auto &[ty, cnt]: vinput.numLocalBlocksPerType)
+        cnt = num_memblocks.getValue();
     }
 
+    Index::BITS = getIndexBits(src_res.index, tgt_res.index);
+    verbose("validate") << "index bits: " << Index::BITS << "\n";
+
     if (fp_bits.getValue() != 0) {
       assert(fp_bits.getValue() < 32 && "Given fp bits are too large");
       vinput.f32NonConstsCount = vinput.f64NonConstsCount =
@@ -821,14 +1214,19 @@ Results validate(
       // Count non-constant floating points whose absolute values are distinct.
       auto countNonConstFps = [](const auto& src_res, const auto& tgt_res,
           bool elemwise) {
+        // Unobservable values may all share one abstract value.
+        size_t uncounted =
+            src_res.hasUncountedValues || tgt_res.hasUncountedValues;
         if (elemwise) {
           return src_res.argCount + // # of variables in argument lists
-            src_res.varCount + tgt_res.varCount; // # of variables in registers
+            src_res.varCount + tgt_res.varCount + // # of variables in registers
+            uncounted;
         } else {
           return src_res.argCount + // # of variables in argument lists
             src_res.varCount + tgt_res.varCount + // # of variables in registers
-            src_res.elemsCount + tgt_res.elemsCount;
+            src_res.elemsCount + tgt_res.elemsCount +
                 // # of ShapedType elements count
+            uncounted;
         }
       };
 
@@ -840,8 +1238,12 @@ Results validate(
           countNonConstFps(src_res.F64, tgt_res.F64, isElementwise);
     }
     vinput.f32Consts = f32_consts;
+    vinput.f32UnobservedConsts = src_res.F32.unobservedConstSet;
+    vinput.f32UnobservedConsts.merge(tgt_res.F32.unobservedConstSet);
     vinput.f32HasInfOrNaN = src_res.F32.hasInfOrNaN | tgt_res.F32.hasInfOrNaN;
     vinput.f64Consts = f64_consts;
+    vinput.f64UnobservedConsts = src_res.F64.unobservedConstSet;
+    vinput.f64UnobservedConsts.merge(tgt_res.F64.unobservedConstSet);
     vinput.f64HasInfOrNaN = src_res.F64.hasInfOrNaN | tgt_res.F64.hasInfOrNaN;
     vinput.isFpAddAssociative = arg_fp_add_associative.getValue();
     vinput.unrollIntSum = arg_unroll_int_sum.getValue();
@@ -0,0 +1,12 @@
+// VERIFY
+// ARGS: --associative
+
+func @f(%x: f32) -> f32 {
+  %c1 = arith.constant 1.0 : f32
+  %c2 = arith.constant 2.0 : f32
+  %c3 = arith.constant 3.0 : f32
+  %a = arith.addf %c2, %c3 : f32
+  %b = arith.addf %x, %c1 : f32
+  %s = arith.addf %b, %a : f32
+  return %s : f32
+}
@@ -0,0 +1,9 @@
+func @f(%x: f32) -> f32 {
+  %c1 = arith.constant 1.0 : f32
+  %c2 = arith.constant 2.0 : f32
+  %c3 = arith.constant 3.0 : f32
+  %a = arith.addf %c3, %c2 : f32
+  %b = arith.addf %x, %a : f32
+  %s = arith.addf %b, %c1 : f32
+  return %s : f32
+}
@@ -0,0 +1,8 @@
+// VERIFY-INCORRECT
+
+// 3.0 is unobservable in src but returned in tgt.
+func @f(%x: f32) -> f32 {
+  %c = arith.constant 3.0 : f32
+  %d = arith.addf %x, %c : f32
+  return %x : f32
+}
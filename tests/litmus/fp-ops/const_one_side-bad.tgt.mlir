@@ -0,0 +1,4 @@
+func @f(%x: f32) -> f32 {
+  %c = arith.constant 3.0 : f32
+  return %c : f32
+}
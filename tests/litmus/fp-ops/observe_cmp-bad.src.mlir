@@ -0,0 +1,8 @@
+// VERIFY-INCORRECT
+
+// %s is observed only through arith.cmpf, so it must still be counted.
+func @f(%x: f32, %y: f32) -> i1 {
+  %s = arith.addf %x, %y : f32
+  %c = arith.cmpf "oeq", %s, %x : f32
+  return %c : i1
+}
@@ -0,0 +1,5 @@
+func @f(%x: f32, %y: f32) -> i1 {
+  %s = arith.mulf %x, %y : f32
+  %c = arith.cmpf "oeq", %s, %x : f32
+  return %c : i1
+}
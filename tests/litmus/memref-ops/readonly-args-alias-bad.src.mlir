@@ -0,0 +1,10 @@
+// VERIFY-INCORRECT
+
+// %a and %b are read-only, but %c may alias both of them.
+func @f(%a: memref<1xi32>, %b: memref<1xi32>, %c: memref<1xi32>) -> i32 {
+  %c0 = arith.constant 0: index
+  %one = arith.constant 1: i32
+  memref.store %one, %c[%c0]: memref<1xi32>
+  %y = memref.load %b[%c0]: memref<1xi32>
+  return %y: i32
+}
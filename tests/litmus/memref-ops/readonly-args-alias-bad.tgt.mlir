@@ -0,0 +1,14 @@
+func @f(%a: memref<1xi32>, %b: memref<1xi32>, %c: memref<1xi32>) -> i32 {
+  %c0 = arith.constant 0: index
+  %one = arith.constant 1: i32
+  %zb = memref.load %b[%c0]: memref<1xi32>
+  %za = memref.load %a[%c0]: memref<1xi32>
+  memref.store %one, %c[%c0]: memref<1xi32>
+  %y = memref.load %b[%c0]: memref<1xi32>
+  %w = memref.load %a[%c0]: memref<1xi32>
+  %da = arith.subi %w, %za: i32
+  %db = arith.subi %y, %zb: i32
+  %m = arith.muli %da, %db: i32
+  %r = arith.addi %y, %m: i32
+  return %r: i32
+}
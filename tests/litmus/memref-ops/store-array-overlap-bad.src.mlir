@@ -0,0 +1,10 @@
+// VERIFY-INCORRECT
+
+// %a and %b may point to overlapping parts of a block, so the stores
+// cannot be swapped.
+func @f(%a: memref<4xi32>, %b: memref<4xi32>, %t1: tensor<4xi32>,
+        %t2: tensor<4xi32>) {
+  memref.tensor_store %t1, %a: memref<4xi32>
+  memref.tensor_store %t2, %b: memref<4xi32>
+  return
+}
@@ -0,0 +1,9 @@
+// VERIFY
+
+// The store to %a[1] partially overlaps the stored tensor.
+func @f(%a: memref<4xi32>, %t: tensor<4xi32>, %x: i32) {
+  %c1 = arith.constant 1: index
+  memref.tensor_store %t, %a: memref<4xi32>
+  memref.store %x, %a[%c1]: memref<4xi32>
+  return
+}
@@ -0,0 +1,6 @@
+func @f(%a: memref<4xi32>, %t: tensor<4xi32>, %x: i32) {
+  %c1 = arith.constant 1: index
+  %t2 = tensor.insert %x into %t[%c1]: tensor<4xi32>
+  memref.tensor_store %t2, %a: memref<4xi32>
+  return
+}
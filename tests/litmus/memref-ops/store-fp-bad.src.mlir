@@ -0,0 +1,8 @@
+// VERIFY-INCORRECT
+
+// %s is observed only through memref.store, so it must still be counted.
+func @f(%a: memref<?xf32>, %i: index, %x: f32, %y: f32) {
+  %s = arith.addf %x, %y : f32
+  memref.store %s, %a[%i]: memref<?xf32>
+  return
+}
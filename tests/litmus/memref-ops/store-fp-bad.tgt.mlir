@@ -0,0 +1,5 @@
+func @f(%a: memref<?xf32>, %i: index, %x: f32, %y: f32) {
+  %s = arith.mulf %x, %y : f32
+  memref.store %s, %a[%i]: memref<?xf32>
+  return
+}
@@ -0,0 +1,7 @@
+func @f(%a: memref<1xi32>, %b: memref<1xi32>) -> i32 {
+  %c0 = arith.constant 0: index
+  %two = arith.constant 2: i32
+  %v = memref.load %b[%c0]: memref<1xi32>
+  memref.store %two, %a[%c0]: memref<1xi32>
+  return %v: i32
+}
@@ -0,0 +1,10 @@
+func @f(%a: memref<1xi32>, %b: memref<1xi32>) -> i32 {
+  %c0 = arith.constant 0: index
+  %one = arith.constant 1: i32
+  %two = arith.constant 2: i32
+  memref.store %one, %a[%c0]: memref<1xi32>
+  %v = memref.load %b[%c0]: memref<1xi32>
+  memref.store %one, %a[%c0]: memref<1xi32>
+  memref.store %two, %a[%c0]: memref<1xi32>
+  return %v: i32
+}
@@ -0,0 +1,9 @@
+// VERIFY
+
+// The second store shadows the first one.
+func @f(%a: memref<?xi32>, %i: index, %x: i32, %y: i32) -> i32 {
+  memref.store %x, %a[%i]: memref<?xi32>
+  memref.store %y, %a[%i]: memref<?xi32>
+  %v = memref.load %a[%i]: memref<?xi32>
+  return %v: i32
+}
@@ -0,0 +1,4 @@
+func @f(%a: memref<?xi32>, %i: index, %x: i32, %y: i32) -> i32 {
+  memref.store %y, %a[%i]: memref<?xi32>
+  return %y: i32
+}
@@ -0,0 +1,9 @@
+#map = affine_map<(d0, d1) -> (d0 * 4 + d1 + 5)>
+func @f(%arg: memref<4x4xf32>) -> f32 {
+  %c0 = arith.constant 0 : index
+  %ts = arith.constant dense<1.0> : tensor<2x2xf32>
+  %x = memref.load %arg[%c0, %c0] : memref<4x4xf32>
+  %v = memref.subview %arg[1, 1][2, 2][1, 1] : memref<4x4xf32> to memref<2x2xf32, #map>
+  memref.tensor_store %ts, %v : memref<2x2xf32, #map>
+  return %x : f32
+}
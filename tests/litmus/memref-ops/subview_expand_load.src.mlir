@@ -0,0 +1,9 @@
+// VERIFY
+
+func @f(%arg0: memref<4x6xf32>) -> f32 {
+  %c1 = arith.constant 1: index
+  %s = memref.subview %arg0[1, 2][2, 4][1, 1] : memref<4x6xf32> to memref<2x4xf32, offset: 8, strides: [6, 1]>
+  %e = memref.expand_shape %s [[0], [1, 2]] : memref<2x4xf32, offset: 8, strides: [6, 1]> into memref<2x2x2xf32, offset: 8, strides: [6, 2, 1]>
+  %v = memref.load %e[%c1, %c1, %c1] : memref<2x2x2xf32, offset: 8, strides: [6, 2, 1]>
+  return %v : f32
+}
@@ -0,0 +1,6 @@
+func @f(%arg0: memref<4x6xf32>) -> f32 {
+  %c2 = arith.constant 2: index
+  %c5 = arith.constant 5: index
+  %v = memref.load %arg0[%c2, %c5] : memref<4x6xf32>
+  return %v : f32
+}
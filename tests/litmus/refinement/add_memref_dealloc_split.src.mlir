@@ -0,0 +1,9 @@
+// EXPECT: "Target operation having undefined behavior: memref.dealloc"
+// ARGS: -split-ub-query
+
+// Deallocating an argument that was not created by memref.alloc is UB
+
+func @test(%arg : memref<2x3xf32>)
+{
+  return
+}
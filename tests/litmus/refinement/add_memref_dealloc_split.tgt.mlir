@@ -0,0 +1,5 @@
+func @test(%arg : memref<2x3xf32>)
+{
+  memref.dealloc %arg: memref<2x3xf32>
+  return
+}
@@ -0,0 +1,7 @@
+// VERIFY
+// ARGS: -slice-queries
+
+func @f(%x: i32, %t: tensor<4xi32>, %i: index) -> (i32, i32) {
+  %e = tensor.extract %t[%i] : tensor<4xi32>
+  return %x, %e : i32, i32
+}
@@ -0,0 +1,8 @@
+func @f(%x: i32, %t: tensor<4xi32>, %i: index) -> (i32, i32) {
+  %c0 = arith.constant 0 : i32
+  %c4 = arith.constant 4 : index
+  %inb = arith.cmpi ult, %i, %c4 : index
+  %r = select %inb, %x, %c0 : i32
+  %e = tensor.extract %t[%i] : tensor<4xi32>
+  return %r, %e : i32, i32
+}
@@ -0,0 +1,17 @@
+// ARGS: -max-const-tensor-size=2
+// VERIFY
+
+// Every row is the same and has two runs, so the constant is encoded
+// precisely in two terms.
+func @f() -> f32 {
+  %cst = arith.constant dense<[[0.0, 0.0, 0.0, 1.0],
+       [0.0, 0.0, 0.0, 1.0],
+       [0.0, 0.0, 0.0, 1.0],
+       [0.0, 0.0, 0.0, 1.0],
+       [0.0, 0.0, 0.0, 1.0],
+       [0.0, 0.0, 0.0, 1.0]]>: tensor<6x4xf32>
+  %c5 = arith.constant 5 : index
+  %c3 = arith.constant 3 : index
+  %v = tensor.extract %cst[%c5, %c3] : tensor<6x4xf32>
+  return %v: f32
+}
@@ -0,0 +1,4 @@
+func @f() -> f32 {
+  %v = arith.constant 1.0 : f32
+  return %v: f32
+}
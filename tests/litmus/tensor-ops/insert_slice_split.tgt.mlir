@@ -0,0 +1,3 @@
+func @insert_slice_split(%arg0: tensor<2x5x10x15xf32>, %arg1: tensor<2x5x10x15xf32>) -> tensor<2x5x10x15xf32> {
+    return %arg0 : tensor<2x5x10x15xf32>
+}
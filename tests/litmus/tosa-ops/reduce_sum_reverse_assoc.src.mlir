@@ -0,0 +1,7 @@
+// VERIFY
+// ARGS: --associative
+
+func @f(%t: tensor<8xf32>) -> tensor<1xf32> {
+  %0 = "tosa.reduce_sum"(%t) {axis = 0 : i64} : (tensor<8xf32>) -> tensor<1xf32>
+  return %0 : tensor<1xf32>
+}
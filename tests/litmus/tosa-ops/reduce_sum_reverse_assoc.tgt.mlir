@@ -0,0 +1,5 @@
+func @f(%t: tensor<8xf32>) -> tensor<1xf32> {
+  %rt = "tosa.reverse"(%t) {axis = 0 : i64} : (tensor<8xf32>) -> tensor<8xf32>
+  %0 = "tosa.reduce_sum"(%rt) {axis = 0 : i64} : (tensor<8xf32>) -> tensor<1xf32>
+  return %0 : tensor<1xf32>
+}
@@ -0,0 +1,7 @@
+// VERIFY
+// ARGS: --unroll-int-sum
+
+func @f(%t: tensor<64xi32>) -> tensor<1xi32> {
+  %0 = "tosa.reduce_sum"(%t) {axis = 0 : i64} : (tensor<64xi32>) -> tensor<1xi32>
+  return %0 : tensor<1xi32>
+}
@@ -0,0 +1,5 @@
+func @f(%t: tensor<64xi32>) -> tensor<1xi32> {
+  %rt = "tosa.reverse"(%t) {axis = 0 : i64} : (tensor<64xi32>) -> tensor<64xi32>
+  %0 = "tosa.reduce_sum"(%rt) {axis = 0 : i64} : (tensor<64xi32>) -> tensor<1xi32>
+  return %0 : tensor<1xi32>
+}
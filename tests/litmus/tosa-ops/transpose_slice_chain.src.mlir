@@ -0,0 +1,9 @@
+// VERIFY
+
+func @f(%arg0: tensor<4x6xf32>) -> tensor<2x2xf32> {
+  %perms = "tosa.const"() {value = dense<[1, 0]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %t = "tosa.transpose"(%arg0, %perms) : (tensor<4x6xf32>, tensor<2xi64>) -> tensor<6x4xf32>
+  %s = tensor.extract_slice %t[1,0][4,3][1,1]: tensor<6x4xf32> to tensor<4x3xf32>
+  %r = tensor.extract_slice %s[1,1][2,2][2,1]: tensor<4x3xf32> to tensor<2x2xf32>
+  return %r: tensor<2x2xf32>
+}
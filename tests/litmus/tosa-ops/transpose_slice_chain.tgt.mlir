@@ -0,0 +1,6 @@
+func @f(%arg0: tensor<4x6xf32>) -> tensor<2x2xf32> {
+  %s = tensor.extract_slice %arg0[1,2][2,2][1,2]: tensor<4x6xf32> to tensor<2x2xf32>
+  %perms = "tosa.const"() {value = dense<[1, 0]> : tensor<2xi64>} : () -> tensor<2xi64>
+  %t = "tosa.transpose"(%s, %perms) : (tensor<2x2xf32>, tensor<2xi64>) -> tensor<2x2xf32>
+  return %t: tensor<2x2xf32>
+}
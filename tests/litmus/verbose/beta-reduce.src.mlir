@@ -0,0 +1,9 @@
+// ARGS: -beta-reduce --verbose
+// EXPECT: "f.2.retval.0: "
+
+func @f(%a: tensor<8xf32>, %b: tensor<8xf32>) -> tensor<8xf32> {
+  %0 = "tosa.add"(%a, %b) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+  %1 = "tosa.mul"(%0, %b) {shift = 0 : i32} : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+  %2 = "tosa.sub"(%1, %a) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+  return %2 : tensor<8xf32>
+}
@@ -0,0 +1,6 @@
+func @f(%a: tensor<8xf32>, %b: tensor<8xf32>) -> tensor<8xf32> {
+  %0 = "tosa.add"(%b, %a) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+  %1 = "tosa.mul"(%b, %0) {shift = 0 : i32} : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+  %2 = "tosa.sub"(%1, %a) : (tensor<8xf32>, tensor<8xf32>) -> tensor<8xf32>
+  return %2 : tensor<8xf32>
+}
@@ -0,0 +1,6 @@
+#map = affine_map<(d0, d1) -> (d0 * 4 + d1 + 16)>
+func @f(%arg: memref<2x2xf32, #map>) {
+  %ts = arith.constant dense<1.0>: tensor<2x2xf32>
+  memref.tensor_store %ts, %arg: memref<2x2xf32, #map>
+  return
+}
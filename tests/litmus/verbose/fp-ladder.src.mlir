@@ -0,0 +1,10 @@
+// ARGS: --verbose
+// EXPECT: "f.2.retval.0: sharing the fp ladders saves nodes"
+
+// Each distinct tosa.add selects from one shared add ladder instead of
+// inlining its own copy.
+func @f(%a: tensor<64x64xf32>, %b: tensor<64x64xf32>, %c: tensor<64x64xf32>) -> tensor<64x64xf32> {
+  %0 = "tosa.add"(%a, %b) : (tensor<64x64xf32>, tensor<64x64xf32>) -> tensor<64x64xf32>
+  %1 = "tosa.add"(%0, %c) : (tensor<64x64xf32>, tensor<64x64xf32>) -> tensor<64x64xf32>
+  return %1 : tensor<64x64xf32>
+}
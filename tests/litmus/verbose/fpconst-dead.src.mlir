@@ -0,0 +1,10 @@
+// ARGS: --verbose
+// EXPECT: "f32 consts count: 0"
+
+// The constant only flows into a value that is never used, so it does not get
+// an abstract representation.
+func @f(%a: tensor<4xf32>) -> tensor<4xf32> {
+  %c = "tosa.const"() {value = dense<3.0> : tensor<4xf32>} : () -> tensor<4xf32>
+  %0 = "tosa.add"(%a, %c) : (tensor<4xf32>, tensor<4xf32>) -> tensor<4xf32>
+  return %a : tensor<4xf32>
+}
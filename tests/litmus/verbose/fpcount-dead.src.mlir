@@ -0,0 +1,8 @@
+// ARGS: --verbose
+// EXPECT: "f32 var count: 0"
+
+// The result of tosa.matmul is never used, so it is not counted.
+func @f(%a: tensor<1x8x8xf32>) -> tensor<1x8x8xf32> {
+  %0 = "tosa.matmul"(%a, %a) : (tensor<1x8x8xf32>, tensor<1x8x8xf32>) -> tensor<1x8x8xf32>
+  return %a : tensor<1x8x8xf32>
+}
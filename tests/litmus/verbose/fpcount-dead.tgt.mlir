@@ -0,0 +1,4 @@
+func @f(%a: tensor<1x8x8xf32>) -> tensor<1x8x8xf32> {
+  %0 = "tosa.matmul"(%a, %a) : (tensor<1x8x8xf32>, tensor<1x8x8xf32>) -> tensor<1x8x8xf32>
+  return %a : tensor<1x8x8xf32>
+}
@@ -0,0 +1,6 @@
+func @f(%a: memref<4xf32>) -> f32 {
+  %c0 = arith.constant 0: index
+  %v = memref.load %a[%c0]: memref<4xf32>
+  %w = arith.addf %v, %v: f32
+  return %w: f32
+}
@@ -0,0 +1,15 @@
+// ARGS: --verbose
+// EXPECT: "memref max live local count (f32): 1"
+func @f() -> f32 {
+  %f0 = arith.constant 1.0: f32
+  %c1 = arith.constant 1: index
+  %p = memref.alloc(): memref<8xf32>
+  memref.store %f0, %p[%c1]: memref<8xf32>
+  %v = memref.load %p[%c1]: memref<8xf32>
+  memref.dealloc %p: memref<8xf32>
+  %q = memref.alloc(): memref<8xf32>
+  memref.store %v, %q[%c1]: memref<8xf32>
+  %w = memref.load %q[%c1]: memref<8xf32>
+  memref.dealloc %q: memref<8xf32>
+  return %w: f32
+}
@@ -0,0 +1,4 @@
+func @f() -> f32 {
+  %f0 = arith.constant 1.0: f32
+  return %f0: f32
+}
@@ -0,0 +1,7 @@
+// ARGS: -scalarize-tensor-size=16 --verbose
+// EXPECT: "f.2.retval.0: use logic QF_UFBV"
+
+func @f(%a: tensor<4xi32>, %b: tensor<4xi32>) -> tensor<4xi32> {
+  %0 = "tosa.add"(%a, %b) : (tensor<4xi32>, tensor<4xi32>) -> tensor<4xi32>
+  return %0 : tensor<4xi32>
+}
@@ -0,0 +1,7 @@
+// ARGS: -smt-tactic=preset -smt-tactic-benchmark --verbose
+// EXPECT: "'preset'"
+
+func @f(%a: i32, %b: i32) -> i32 {
+  %c = arith.addi %a, %b : i32
+  return %c : i32
+}
@@ -0,0 +1,4 @@
+func @f(%a: i32, %b: i32) -> i32 {
+  %c = arith.addi %b, %a : i32
+  return %c : i32
+}